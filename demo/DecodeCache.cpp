@@ -0,0 +1,155 @@
+#include "DecodeCache.hpp"
+
+#include <Pulsejet/Meta.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+
+// Entry file layout (little-endian, like the rest of the demo):
+//  - Tag (4 bytes)
+//  - Entry format version (u32)
+//  - Key (u64)
+//  - Encoded sample size (u32)
+//  - Number of decoded samples (u32)
+//  - Reserved, zero (8 bytes), keeping the samples 16-byte aligned
+//  - Decoded samples (f32 * number of decoded samples)
+static const char *EntryTag = "PJDC";
+static const uint32_t EntryFormatVersion = 1;
+static const size_t EntryHeaderSize = 32;
+
+// Version of the decoded output, which is part of each entry's key
+//  This must be bumped whenever `Decode` (or the demo's shims) produce different samples for the same encoded sample, so
+//  that stale entries are never used. The library version alone isn't enough, as it doesn't change with every fix.
+//  1: Initial version
+//  2: Batch `FastSinusoids` match the scalar versions exactly
+static const uint32_t DecoderFormatVersion = 2;
+
+// 64-bit FNV-1a
+static uint64_t Hash(uint64_t hash, const void *data, size_t size)
+{
+	const auto bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint32_t ReadU32(const uint8_t *p)
+{
+	uint32_t ret;
+	memcpy(&ret, p, sizeof(ret));
+	return ret;
+}
+
+static uint64_t ReadU64(const uint8_t *p)
+{
+	uint64_t ret;
+	memcpy(&ret, p, sizeof(ret));
+	return ret;
+}
+
+// Returns whether a mapped entry file is complete and matches the given key and encoded sample size
+//  Keys are only 64 bits, so the encoded sample size is checked as well, to make collisions even less likely.
+static bool IsValidEntry(const MappedFile& file, uint64_t key, size_t encodedSampleSize)
+{
+	const auto data = file.Data();
+	if (file.Size() < EntryHeaderSize || memcmp(data, EntryTag, 4))
+		return false;
+	if (ReadU32(data + 4) != EntryFormatVersion || ReadU64(data + 8) != key || ReadU32(data + 16) != encodedSampleSize)
+		return false;
+	const auto numSamples = ReadU32(data + 20);
+	return file.Size() == EntryHeaderSize + static_cast<size_t>(numSamples) * sizeof(float);
+}
+
+DecodeCache::DecodeCache(const char *directory, const char *decoderVersion, DecodeFunction decode)
+	: directory(directory), decoderVersion(decoderVersion), decode(decode)
+{
+}
+
+void DecodeCache::Decode(const uint8_t *encodedSample, size_t encodedSampleSize, CachedSample& out) const
+{
+	out.file.Close();
+	out.uncachedSamples.clear();
+
+	// Determine key and entry file name
+	const auto libraryVersion = Pulsejet::LibraryVersionString();
+	auto key = Hash(0xcbf29ce484222325ull, &DecoderFormatVersion, sizeof(DecoderFormatVersion));
+	key = Hash(key, libraryVersion.c_str(), libraryVersion.size() + 1);
+	key = Hash(key, decoderVersion.c_str(), decoderVersion.size() + 1);
+	key = Hash(key, encodedSample, encodedSampleSize);
+	char keyString[17];
+	snprintf(keyString, sizeof(keyString), "%016llx", static_cast<unsigned long long>(key));
+	const auto entryPath = filesystem::path(directory) / (string(keyString) + ".pjdc");
+
+	// Use the existing entry, if any
+	//  Entries stay mapped for as long as their samples are in use (eg. played back from arbitrary positions), so they're
+	//  not mapped for sequential access like inputs
+	if (out.file.OpenRead(entryPath.string().c_str(), MappedFile::AccessHint::Normal) && IsValidEntry(out.file, key, encodedSampleSize))
+	{
+		out.samples = reinterpret_cast<const float *>(out.file.Data() + EntryHeaderSize);
+		out.numSamples = ReadU32(out.file.Data() + 20);
+		out.isHit = true;
+		return;
+	}
+	out.file.Close();
+	out.isHit = false;
+
+	// Decode sample
+	uint32_t numSamples;
+	const auto samples = decode(encodedSample, &numSamples);
+
+	// Write the entry to a temporary file, and move it into place once complete and on disk, so that a crash can't leave
+	//  a renamed but incomplete entry behind
+	//  Failing to write the entry isn't an error; the decoded samples are simply returned from memory instead.
+	error_code errorCode;
+	filesystem::create_directories(directory, errorCode);
+	const auto tempPath = filesystem::path(directory) / (string(keyString) + "." + to_string(random_device()()) + ".tmp");
+	auto isWritten = false;
+	{
+		MappedFile tempFile;
+		const auto sampleDataSize = static_cast<size_t>(numSamples) * sizeof(float);
+		if (tempFile.Create(tempPath.string().c_str(), EntryHeaderSize + sampleDataSize))
+		{
+			const auto data = tempFile.Data();
+			const auto encodedSampleSize32 = static_cast<uint32_t>(encodedSampleSize);
+			memset(data, 0, EntryHeaderSize);
+			memcpy(data, EntryTag, 4);
+			memcpy(data + 4, &EntryFormatVersion, sizeof(EntryFormatVersion));
+			memcpy(data + 8, &key, sizeof(key));
+			memcpy(data + 16, &encodedSampleSize32, sizeof(encodedSampleSize32));
+			memcpy(data + 20, &numSamples, sizeof(numSamples));
+			if (sampleDataSize)
+				memcpy(data + EntryHeaderSize, samples, sampleDataSize);
+			isWritten = tempFile.Flush();
+		}
+	}
+	if (isWritten)
+	{
+		filesystem::rename(tempPath, entryPath, errorCode);
+		isWritten = !errorCode;
+	}
+	if (!isWritten)
+		filesystem::remove(tempPath, errorCode);
+
+	// Map the new entry, so that hits and misses are used the same way
+	if (isWritten && out.file.OpenRead(entryPath.string().c_str(), MappedFile::AccessHint::Normal) && IsValidEntry(out.file, key, encodedSampleSize))
+	{
+		out.samples = reinterpret_cast<const float *>(out.file.Data() + EntryHeaderSize);
+		out.numSamples = numSamples;
+	}
+	else
+	{
+		out.file.Close();
+		out.uncachedSamples.assign(samples, samples + numSamples);
+		out.samples = out.uncachedSamples.data();
+		out.numSamples = numSamples;
+	}
+
+	delete [] samples;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A sample returned by `DecodeCache::Decode`, pointing either into its mapped cache entry, or (if the entry couldn't be
+//  written) into a decoded copy held in memory
+struct CachedSample
+{
+	MappedFile file;
+	std::vector<float> uncachedSamples;
+	const float *samples = nullptr;
+	uint32_t numSamples = 0;
+	// Whether the sample was found in the cache, rather than decoded
+	bool isHit = false;
+};
+
+// Persistent, content-addressed cache of decoded samples, for tools that decode the same samples every time a project
+//  is loaded
+//  Each entry is a file in the cache directory, named by a 64-bit hash of the encoded sample and the decoder version,
+//  containing a small header followed by the decoded float samples, so that hits are used directly from the mapped file.
+//  The decoder version consists of the cache's decoder format version (bumped whenever decoded output changes), the
+//  library version, and a caller-provided string identifying the decode function and its shims, as different shims (eg.
+//  `FastSinusoids` vs. libm) produce slightly different samples. Entries are written to a temporary file, flushed to
+//  disk, and renamed into place, so that interrupted or concurrent writers (or crashes) never leave partial entries
+//  behind. Stale entries are never removed; the cache directory can simply be deleted at any time.
+class DecodeCache
+{
+public:
+	using DecodeFunction = float *(*)(const uint8_t *inputStream, uint32_t *outNumSamples);
+
+	// `decode` must return a buffer allocated with `new []`, like `Pulsejet::Decode`
+	DecodeCache(const char *directory, const char *decoderVersion, DecodeFunction decode);
+
+	// Looks up the given encoded sample (which must be a valid pulsejet sample) in the cache, decoding it and adding it to
+	//  the cache if it's missing
+	void Decode(const uint8_t *encodedSample, size_t encodedSampleSize, CachedSample& out) const;
+
+private:
+	std::string directory;
+	std::string decoderVersion;
+	DecodeFunction decode;
+};
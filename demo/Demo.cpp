@@ -8,6 +8,11 @@ namespace Pulsejet::Shims
 		return FastSinusoids::CosF(x);
 	}
 
+	inline void CosF(const float *x, float *out, uint32_t n)
+	{
+		FastSinusoids::CosF(x, out, n);
+	}
+
 	inline float Exp2f(float x)
 	{
 		return exp2f(x);
@@ -18,26 +23,49 @@ namespace Pulsejet::Shims
 		return FastSinusoids::SinF(x);
 	}
 
+	inline void SinF(const float *x, float *out, uint32_t n)
+	{
+		FastSinusoids::SinF(x, out, n);
+	}
+
 	inline float SqrtF(float x)
 	{
 		return sqrtf(x);
 	}
 }
+
+// The decoder's IMDCT cosine tables are only built once per run, and make decoding much faster
+#define PULSEJET_IMDCT_COSINE_TABLES
 #include <Pulsejet/Pulsejet.hpp>
 
+#include "DecodeCache.hpp"
+#include "MappedFile.hpp"
+#include "Wav.hpp"
+
+#include <cctype>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <string>
 #include <vector>
 using namespace std;
 
+// Identifies the shims above in decode cache keys, as other shims decode to slightly different samples
+static const char *DecoderVersion = "FastSinusoids";
+
 static void PrintUsage(const char **argv)
 {
 	cout << "Usage:\n";
-	cout << "  encode: " << argv[0] << " -e <target bit rate in kbps> <input.raw> <output.pulsejet>\n";
-	cout << "  decode: " << argv[0] << " -d <input.pulsejet> <output.raw>\n";
+	cout << "  encode: " << argv[0] << " -e <target bit rate in kbps> <input.raw|input.wav> <output.pulsejet>\n";
+	cout << "  encode (frame-interleaved layout): " << argv[0] << " -ei <target bit rate in kbps> <input.raw|input.wav> <output.pulsejet>\n";
+	cout << "  decode: " << argv[0] << " -d <input.pulsejet> <output.raw|output.wav> [<wav sample format: 16, 24 or 32f (default)> [<wav sample rate in hz (default 44100)>]]\n";
+	cout << "  decode (with decode cache): " << argv[0] << " -dc <cache directory> <input.pulsejet> <output.raw|output.wav> [<wav sample format: 16, 24 or 32f (default)> [<wav sample rate in hz (default 44100)>]]\n";
+	cout << "  bank encode: " << argv[0] << " -b <byte budget> <input.raw|input.wav> <output.pulsejet> [<input.raw|input.wav> <output.pulsejet> ...]\n";
+	cout << "\n";
+	cout << ".raw files contain mono 32-bit float samples at 44100hz. .wav files may contain 16/24-bit integer or 32-bit float samples, and are downmixed to mono.\n";
+	cout << "Encoded samples don't store a sample rate, so samples encoded from .wav files at other rates must be decoded with the same wav sample rate.\n";
 }
 
 static void ErrorInvalidArgs(const char **argv)
@@ -46,33 +74,108 @@ static void ErrorInvalidArgs(const char **argv)
 	PrintUsage(argv);
 }
 
-static vector<uint8_t> ReadFile(const char *fileName)
+static bool IsWavFileName(const char *fileName)
+{
+	const auto length = strlen(fileName);
+	if (length < 4)
+		return false;
+	string extension(fileName + length - 4);
+	for (auto& c : extension)
+		c = static_cast<char>(tolower(c));
+	return extension == ".wav";
+}
+
+// Input samples, pointing either directly into the mapped input file (for raw and mono 32-bit float wav files),
+//  or into a converted copy of its samples
+struct InputSamples
 {
-	ifstream inputFile(fileName, ios::binary | ios::ate);
-	const auto inputFileSize = inputFile.tellg();
-	inputFile.seekg(0, ios::beg);
+	MappedFile file;
+	vector<float> convertedSamples;
+	const float *samples = nullptr;
+	uint32_t numSamples = 0;
+	double sampleRate = 44100.0;
+};
 
-	vector<uint8_t> ret(inputFileSize);
-	inputFile.read(reinterpret_cast<char *>(ret.data()), inputFileSize);
+static bool ReadInputSamples(const char *fileName, InputSamples& out)
+{
+	if (!out.file.OpenRead(fileName, MappedFile::AccessHint::Sequential))
+	{
+		cout << "ERROR: Couldn't read " << fileName << "\n\n";
+		return false;
+	}
 
-	return ret;
+	if (Wav::IsWav(out.file.Data(), out.file.Size()))
+	{
+		Wav::Info info;
+		if (const auto error = Wav::Parse(out.file.Data(), out.file.Size(), info))
+		{
+			cout << "ERROR: " << fileName << ": " << error << "\n\n";
+			return false;
+		}
+		out.numSamples = info.numFrames;
+		out.sampleRate = static_cast<double>(info.sampleRate);
+		out.samples = Wav::MonoFloatSamples(info);
+		if (!out.samples)
+		{
+			out.convertedSamples.resize(info.numFrames);
+			Wav::ReadMono(info, out.convertedSamples.data());
+			out.samples = out.convertedSamples.data();
+		}
+	}
+	else
+	{
+		if (out.file.Size() % sizeof(float))
+		{
+			cout << "ERROR: Input size is not aligned to float size\n\n";
+			return false;
+		}
+		out.numSamples = static_cast<uint32_t>(out.file.Size() / sizeof(float));
+		out.samples = reinterpret_cast<const float *>(out.file.Data());
+	}
+
+	if (out.sampleRate != 44100.0)
+		cout << "(warning: " << fileName << " is " << out.sampleRate << "hz; pulsejet is designed for 44100hz, and decoding it to .wav requires passing this sample rate) " << flush;
+
+	return true;
 }
 
-static vector<float> ReadFileAsFloats(const char *fileName)
+static bool WriteOutputFile(const char *fileName, const uint8_t *data, size_t size)
 {
-	ifstream inputFile(fileName, ios::binary | ios::ate);
-	const auto inputFileSize = inputFile.tellg();
-	if (inputFileSize % sizeof(float))
+	MappedFile outputFile;
+	if (!outputFile.Create(fileName, size))
 	{
-		cout << "ERROR: Input size is not aligned to float size\n\n";
-		return 1;
+		cout << "ERROR: Couldn't write " << fileName << "\n\n";
+		return false;
 	}
-	inputFile.seekg(0, ios::beg);
+	if (size)
+		memcpy(outputFile.Data(), data, size);
+	if (!outputFile.Flush())
+	{
+		cout << "ERROR: Couldn't write " << fileName << "\n\n";
+		return false;
+	}
+	return true;
+}
 
-	vector<float> ret(inputFileSize);
-	inputFile.read(reinterpret_cast<char *>(ret.data()), inputFileSize);
+static bool WriteOutputSamples(const char *fileName, const float *samples, uint32_t numSamples, Wav::SampleFormat wavSampleFormat, uint32_t wavSampleRate)
+{
+	if (!IsWavFileName(fileName))
+		return WriteOutputFile(fileName, reinterpret_cast<const uint8_t *>(samples), numSamples * sizeof(float));
 
-	return ret;
+	// Convert samples directly into the mapped output file
+	MappedFile outputFile;
+	if (!outputFile.Create(fileName, Wav::FileSize(numSamples, wavSampleFormat)))
+	{
+		cout << "ERROR: Couldn't write " << fileName << "\n\n";
+		return false;
+	}
+	Wav::Write(outputFile.Data(), samples, numSamples, wavSampleRate, wavSampleFormat);
+	if (!outputFile.Flush())
+	{
+		cout << "ERROR: Couldn't write " << fileName << "\n\n";
+		return false;
+	}
+	return true;
 }
 
 int main(int argc, const char **argv)
@@ -88,7 +191,7 @@ int main(int argc, const char **argv)
 
 	FastSinusoids::Init();
 
-	if (!strcmp(argv[1], "-e"))
+	if (!strcmp(argv[1], "-e") || !strcmp(argv[1], "-ei"))
 	{
 		if (argc != 5)
 		{
@@ -101,72 +204,183 @@ int main(int argc, const char **argv)
 		const auto outputFileName = argv[4];
 
 		cout << "reading ... " << flush;
-		const auto input = ReadFileAsFloats(inputFileName);
+		InputSamples input;
+		if (!ReadInputSamples(inputFileName, input))
+			return 1;
 		cout << "ok\n";
 
 		cout << "encoding ... " << flush;
-		const uint32_t numSamples = input.size();
-		const double sampleRate = 44100.0;
+		const auto numSamples = input.numSamples;
+		const auto sampleRate = input.sampleRate;
 		double totalBitsEstimate;
-		const auto encodedSample = Pulsejet::Encode(input.data(), numSamples, sampleRate, targetBitRate, totalBitsEstimate);
+		Pulsejet::EncodeOptions options;
+		if (!strcmp(argv[1], "-ei"))
+			options.layout = Pulsejet::StreamLayout::Interleaved;
+		const auto encodedSample = Pulsejet::Encode(input.samples, numSamples, sampleRate, targetBitRate, totalBitsEstimate, options);
+		if (encodedSample.empty())
+		{
+			cout << "ERROR: Input is too long to encode\n\n";
+			return 1;
+		}
 		const auto bitRateEstimate = totalBitsEstimate / 1000.0 / (static_cast<double>(numSamples) / sampleRate);
 		cout << "ok, compressed size estimate: " << static_cast<uint32_t>(ceil(totalBitsEstimate / 8.0)) << " byte(s) (~" << setprecision(4) << bitRateEstimate << "kbps)\n";
 
 		cout << "writing ... " << flush;
-		ofstream outputFile(outputFileName, ios::binary);
-		outputFile.write(reinterpret_cast<const char *>(encodedSample.data()), encodedSample.size());
+		if (!WriteOutputFile(outputFileName, encodedSample.data(), encodedSample.size()))
+			return 1;
 		cout << "ok\n";
 
 		cout << "encoding successful!\n";
 	}
-	else if (!strcmp(argv[1], "-d"))
+	else if (!strcmp(argv[1], "-d") || !strcmp(argv[1], "-dc"))
 	{
-		if (argc != 4)
+		// With -dc, decoded samples are looked up in (and added to) a decode cache in the given directory, and the
+		//  remaining args are the same as for -d
+		const auto cacheDirectory = !strcmp(argv[1], "-dc") ? argv[2] : nullptr;
+		const auto args = cacheDirectory ? argv + 1 : argv;
+		const auto numArgs = cacheDirectory ? argc - 1 : argc;
+		if (numArgs < 4 || numArgs > 6)
 		{
 			ErrorInvalidArgs(argv);
 			return 1;
 		}
 
-		const auto inputFileName = argv[2];
-		const auto outputFileName = argv[3];
+		const auto inputFileName = args[2];
+		const auto outputFileName = args[3];
+
+		auto wavSampleFormat = Wav::SampleFormat::Float32;
+		if (numArgs >= 5)
+		{
+			if (!strcmp(args[4], "16"))
+				wavSampleFormat = Wav::SampleFormat::Int16;
+			else if (!strcmp(args[4], "24"))
+				wavSampleFormat = Wav::SampleFormat::Int24;
+			else if (strcmp(args[4], "32f"))
+			{
+				ErrorInvalidArgs(argv);
+				return 1;
+			}
+		}
+
+		uint32_t wavSampleRate = 44100;
+		if (numArgs == 6)
+		{
+			char *end;
+			const auto sampleRate = strtoull(args[5], &end, 10);
+			if (!isdigit(static_cast<unsigned char>(args[5][0])) || *end || !sampleRate || sampleRate > UINT32_MAX)
+			{
+				ErrorInvalidArgs(argv);
+				return 1;
+			}
+			wavSampleRate = static_cast<uint32_t>(sampleRate);
+		}
 
 		cout << "reading ... " << flush;
-		const auto input = ReadFile(inputFileName);
+		MappedFile inputFile;
+		if (!inputFile.OpenRead(inputFileName, MappedFile::AccessHint::Sequential))
+		{
+			cout << "ERROR: Couldn't read " << inputFileName << "\n\n";
+			return 1;
+		}
+		const auto input = inputFile.Data();
 		cout << "ok\n";
 
 		cout << "sample check ... " << flush;
-		if (!Pulsejet::CheckSample(input.data()))
+		if (inputFile.Size() < 10 || !Pulsejet::CheckSample(input))
 		{
 			cout << "ERROR: Input is not a pulsejet sample\n\n";
 			return 1;
 		}
 		cout << "ok\n";
 
-		cout << "sample version: " << Pulsejet::SampleVersionString(input.data()) << "\n";
+		cout << "sample version: " << Pulsejet::SampleVersionString(input) << "\n";
 		cout << "sample version check ... " << flush;
-		if (!Pulsejet::CheckSampleVersion(input.data()))
+		if (!Pulsejet::CheckSampleVersion(input))
 		{
 			cout << "ERROR: Incompatible codec and sample versions\n\n";
 			return 1;
 		}
 		cout << "ok\n";
 
+		cout << "sample layout: " << (Pulsejet::SampleLayout(input) == Pulsejet::StreamLayout::Interleaved ? "interleaved" : "concatenated") << "\n";
+
 		cout << "decoding ... " << flush;
+		CachedSample cachedSample;
+		float *decodedSample = nullptr;
+		const float *samples;
 		uint32_t numDecodedSamples;
-		const auto decodedSample = Pulsejet::Decode(input.data(), &numDecodedSamples);
-		cout << "ok, " << numDecodedSamples << " samples\n";
+		if (cacheDirectory)
+		{
+			DecodeCache(cacheDirectory, DecoderVersion, Pulsejet::Decode).Decode(input, inputFile.Size(), cachedSample);
+			samples = cachedSample.samples;
+			numDecodedSamples = cachedSample.numSamples;
+			cout << "ok (cache " << (cachedSample.isHit ? "hit" : "miss") << "), " << numDecodedSamples << " samples\n";
+		}
+		else
+		{
+			decodedSample = Pulsejet::Decode(input, &numDecodedSamples);
+			samples = decodedSample;
+			cout << "ok, " << numDecodedSamples << " samples\n";
+		}
 
 		cout << "writing ... " << flush;
-		ofstream outputFile(outputFileName, ios::binary);
-		outputFile.write(reinterpret_cast<const char *>(decodedSample), numDecodedSamples * sizeof(float));
-		cout << "ok\n";
+		const auto isWritten = WriteOutputSamples(outputFileName, samples, numDecodedSamples, wavSampleFormat, wavSampleRate);
+		if (isWritten)
+			cout << "ok\n";
 
 		cout << "cleanup ... " << flush;
 		delete [] decodedSample;
 		cout << "ok\n";
 
+		if (!isWritten)
+			return 1;
+
 		cout << "decoding successful!\n";
 	}
+	else if (!strcmp(argv[1], "-b"))
+	{
+		if (argc < 5 || (argc - 3) % 2)
+		{
+			ErrorInvalidArgs(argv);
+			return 1;
+		}
+
+		const auto byteBudget = static_cast<size_t>(stoull(argv[2]));
+		const auto numInputs = static_cast<uint32_t>((argc - 3) / 2);
+
+		cout << "reading ... " << flush;
+		vector<InputSamples> inputs(numInputs);
+		for (uint32_t i = 0; i < numInputs; i++)
+		{
+			if (!ReadInputSamples(argv[3 + i * 2], inputs[i]))
+				return 1;
+		}
+		cout << "ok\n";
+
+		cout << "encoding ... " << flush;
+		vector<Pulsejet::BankSample> samples;
+		for (const auto& input : inputs)
+			samples.push_back({ input.samples, input.numSamples, input.sampleRate });
+		const auto result = Pulsejet::EncodeBank(samples, byteBudget);
+		cout << "ok, compressed size estimate: " << static_cast<uint32_t>(ceil(result.totalBitsEstimate / 8.0)) << " of " << byteBudget << " byte(s)\n";
+
+		for (uint32_t i = 0; i < numInputs; i++)
+		{
+			const auto outputFileName = argv[4 + i * 2];
+			if (result.encodedSamples[i].empty())
+			{
+				cout << "ERROR: " << argv[3 + i * 2] << " is too long to encode\n\n";
+				return 1;
+			}
+			const auto bitRateEstimate = result.bitsEstimates[i] / 1000.0 / (static_cast<double>(inputs[i].numSamples) / inputs[i].sampleRate);
+			cout << "writing " << outputFileName << " (compressed size estimate: " << static_cast<uint32_t>(ceil(result.bitsEstimates[i] / 8.0)) << " byte(s), ~" << setprecision(4) << bitRateEstimate << "kbps) ... " << flush;
+			if (!WriteOutputFile(outputFileName, result.encodedSamples[i].data(), result.encodedSamples[i].size()))
+				return 1;
+			cout << "ok\n";
+		}
+
+		cout << "encoding successful!\n";
+	}
 	else
 	{
 		ErrorInvalidArgs(argv);
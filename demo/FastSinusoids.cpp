@@ -2,6 +2,11 @@
 
 #include <cstdint>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FAST_SINUSOIDS_SSE2
+#include <emmintrin.h>
+#endif
+
 static inline constexpr uint32_t fastCosTabLog2Size = 10; // size = 1024
 static inline constexpr uint32_t fastCosTabSize = 1 << fastCosTabLog2Size;
 static double fastCosTab[fastCosTabSize + 1];
@@ -42,4 +47,77 @@ namespace FastSinusoids
 		const auto fractMix = fract * (1.0 / fractScale);
 		return left + (right - left) * fractMix;
 	}
+
+	// Evaluates `Cos(x[i] + phaseOffset)` (in double precision) for each element, rounding the results to float
+	//  The SSE2 path reproduces `Cos` exactly, including its rounding of the phase (when adding 1) and its truncation of
+	//  the table interpolation fraction to `32 - fastCosTabLog2Size` bits, so batch and scalar shims give identical
+	//  results.
+	static void CosBatch(const float *x, float *out, uint32_t n, double phaseOffset)
+	{
+		uint32_t i = 0;
+
+#ifdef FAST_SINUSOIDS_SSE2
+		const auto absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffll));
+		const auto offset = _mm_set1_pd(phaseOffset);
+		const auto one = _mm_set1_pd(1.0);
+		const auto phaseScale = _mm_set1_pd(1.0 / (M_PI * 2.0));
+		const auto tabScale = _mm_set1_pd(static_cast<double>(fastCosTabSize));
+		const auto fractScale = 1 << (32 - fastCosTabLog2Size);
+		const auto fractBitsScale = _mm_set1_pd(static_cast<double>(fractScale));
+		const auto fractMixScale = _mm_set1_pd(1.0 / fractScale);
+		// Phases whose integer part doesn't fit in 32 bits are left to `Cos`
+		const auto maxPhase = _mm_set1_pd(2147483648.0);
+		for (; i + 4 <= n; i += 4)
+		{
+			const auto xs = _mm_loadu_ps(x + i);
+			const __m128d halves[2] =
+			{
+				_mm_cvtps_pd(xs),
+				_mm_cvtps_pd(_mm_movehl_ps(xs, xs)),
+			};
+
+			alignas(16) double results[4];
+			auto isInRange = true;
+			for (uint32_t half = 0; half < 2; half++)
+			{
+				// Normalize range from 0..2PI to 1..2, like `Cos`, and reduce to the fractional part (which is exact)
+				const auto phase = _mm_add_pd(one, _mm_mul_pd(_mm_and_pd(_mm_add_pd(halves[half], offset), absMask), phaseScale));
+				isInRange = isInRange && !_mm_movemask_pd(_mm_cmpge_pd(phase, maxPhase));
+				const auto fractPhase = _mm_sub_pd(phase, _mm_cvtepi32_pd(_mm_cvttpd_epi32(phase)));
+
+				// Split into table index and interpolation fraction; `Cos` takes these from the top 32 fraction bits
+				const auto position = _mm_mul_pd(fractPhase, tabScale);
+				const auto indices = _mm_cvttpd_epi32(position);
+				const auto fract = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(position, _mm_cvtepi32_pd(indices)), fractBitsScale)));
+				const auto fractMix = _mm_mul_pd(fract, fractMixScale);
+
+				// Gather table entries and lerp
+				alignas(16) int32_t index[4];
+				_mm_store_si128(reinterpret_cast<__m128i *>(index), indices);
+				const auto left = _mm_set_pd(fastCosTab[index[1]], fastCosTab[index[0]]);
+				const auto right = _mm_set_pd(fastCosTab[index[1] + 1], fastCosTab[index[0] + 1]);
+				_mm_store_pd(results + half * 2, _mm_add_pd(left, _mm_mul_pd(_mm_sub_pd(right, left), fractMix)));
+			}
+			if (!isInRange)
+				break;
+
+			const auto lo = _mm_cvtpd_ps(_mm_load_pd(results));
+			const auto hi = _mm_cvtpd_ps(_mm_load_pd(results + 2));
+			_mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+		}
+#endif
+
+		for (; i < n; i++)
+			out[i] = static_cast<float>(Cos(static_cast<double>(x[i]) + phaseOffset));
+	}
+
+	void CosF(const float *x, float *out, uint32_t n)
+	{
+		CosBatch(x, out, n, 0.0);
+	}
+
+	void SinF(const float *x, float *out, uint32_t n)
+	{
+		CosBatch(x, out, n, -M_PI_2);
+	}
 }
@@ -2,6 +2,7 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cstdint>
 
 namespace FastSinusoids
 {
@@ -19,4 +20,8 @@ namespace FastSinusoids
 	{
 		return static_cast<float>(Sin(static_cast<double>(x)));
 	}
+
+	// Batch versions, giving exactly the same results as the scalar versions; `x` and `out` may point to the same buffer
+	void CosF(const float *x, float *out, uint32_t n);
+	void SinF(const float *x, float *out, uint32_t n);
 }
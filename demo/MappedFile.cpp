@@ -0,0 +1,217 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+// Maps the whole file behind `fileHandle`, which must be `size` bytes long
+static bool Map(HANDLE fileHandle, size_t size, bool writable, void *& outMappingHandle, uint8_t *& outData)
+{
+	// Empty files can't be mapped, but there's nothing to map anyways
+	if (!size)
+		return true;
+
+	const auto sizeHigh = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+	const auto sizeLow = static_cast<DWORD>(size);
+	outMappingHandle = CreateFileMappingA(fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, sizeHigh, sizeLow, nullptr);
+	if (!outMappingHandle)
+		return false;
+
+	outData = static_cast<uint8_t *>(MapViewOfFile(outMappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+	return outData != nullptr;
+}
+
+bool MappedFile::OpenRead(const char *fileName, AccessHint accessHint)
+{
+	Close();
+
+	const DWORD flags = accessHint == AccessHint::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+	fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	if (!Map(fileHandle, size, false, mappingHandle, data))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::Create(const char *fileName, size_t size)
+{
+	Close();
+
+	fileHandle = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+	this->size = size;
+
+	// Allocate the file at its final size up front, so that running out of disk space fails here rather than when the
+	//  mapping is written
+	if (size)
+	{
+		LARGE_INTEGER fileSize;
+		fileSize.QuadPart = static_cast<LONGLONG>(size);
+		if (!SetFilePointerEx(fileHandle, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	if (!Map(fileHandle, size, true, mappingHandle, data))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::Flush()
+{
+	if (data && !FlushViewOfFile(data, 0))
+		return false;
+	return !fileHandle || FlushFileBuffers(fileHandle);
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	data = nullptr;
+	size = 0;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+}
+
+#else
+
+// Allocates the blocks of a file extended to `size` bytes, rather than leaving it sparse, so that running out of disk
+//  space fails here rather than raising SIGBUS when the mapping is written
+static bool Preallocate(int fileDescriptor, size_t size)
+{
+#ifdef __APPLE__
+	fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0 };
+	if (fcntl(fileDescriptor, F_PREALLOCATE, &store) == -1)
+		return false;
+	return !ftruncate(fileDescriptor, static_cast<off_t>(size));
+#else
+	return !posix_fallocate(fileDescriptor, 0, static_cast<off_t>(size));
+#endif
+}
+
+bool MappedFile::OpenRead(const char *fileName, AccessHint accessHint)
+{
+	Close();
+
+	fileDescriptor = open(fileName, O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat))
+	{
+		Close();
+		return false;
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files can't be mapped, but there's nothing to map anyways
+	if (!size)
+		return true;
+
+	const auto mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	data = static_cast<uint8_t *>(mapping);
+
+	if (accessHint == AccessHint::Sequential)
+		madvise(mapping, size, MADV_SEQUENTIAL);
+
+	return true;
+}
+
+bool MappedFile::Create(const char *fileName, size_t size)
+{
+	Close();
+
+	fileDescriptor = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fileDescriptor < 0)
+		return false;
+
+	if (!size)
+		return true;
+
+	if (!Preallocate(fileDescriptor, size))
+	{
+		Close();
+		return false;
+	}
+	this->size = size;
+
+	const auto mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	data = static_cast<uint8_t *>(mapping);
+
+	return true;
+}
+
+bool MappedFile::Flush()
+{
+	if (data && msync(data, size, MS_SYNC))
+		return false;
+	return fileDescriptor < 0 || !fsync(fileDescriptor);
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		munmap(data, size);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	data = nullptr;
+	size = 0;
+	fileDescriptor = -1;
+}
+
+#endif
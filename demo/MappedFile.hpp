@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A whole file mapped into memory, either read-only (for inputs) or writable (for outputs, which are
+//  created and allocated with their final size up front)
+class MappedFile
+{
+public:
+	// How a file opened for reading is going to be accessed, which is passed on to the OS as a hint
+	enum class AccessHint
+	{
+		// No particular pattern (eg. for files that are kept around and accessed randomly)
+		Normal,
+		// Read front to back once, so pages can be read ahead aggressively and dropped soon after
+		Sequential,
+	};
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator =(const MappedFile&) = delete;
+	~MappedFile();
+
+	// Maps an existing file for reading
+	bool OpenRead(const char *fileName, AccessHint accessHint);
+	// Creates (or truncates) a file with the given size, allocating its storage, and maps it for writing
+	bool Create(const char *fileName, size_t size);
+	// Writes any modified data through to disk, returning whether it succeeded
+	bool Flush();
+	// Unmaps and closes the file, if any; written data is flushed to the file by the OS, but errors can only be
+	//  detected by calling `Flush` first
+	void Close();
+
+	const uint8_t *Data() const
+	{
+		return data;
+	}
+
+	uint8_t *Data()
+	{
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+private:
+	uint8_t *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,235 @@
+#include "Wav.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace Wav
+{
+	static const uint16_t FormatPcm = 1;
+	static const uint16_t FormatFloat = 3;
+	static const uint16_t FormatExtensible = 0xfffe;
+
+	static uint16_t ReadU16(const uint8_t *p)
+	{
+		uint16_t ret;
+		memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+
+	static uint32_t ReadU32(const uint8_t *p)
+	{
+		uint32_t ret;
+		memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+
+	static uint8_t *WriteU16(uint8_t *p, uint16_t x)
+	{
+		memcpy(p, &x, sizeof(x));
+		return p + sizeof(x);
+	}
+
+	static uint8_t *WriteU32(uint8_t *p, uint32_t x)
+	{
+		memcpy(p, &x, sizeof(x));
+		return p + sizeof(x);
+	}
+
+	static uint8_t *WriteTag(uint8_t *p, const char *tag)
+	{
+		memcpy(p, tag, 4);
+		return p + 4;
+	}
+
+	static uint32_t BytesPerSample(SampleFormat sampleFormat)
+	{
+		return sampleFormat == SampleFormat::Int16 ? 2 : sampleFormat == SampleFormat::Int24 ? 3 : 4;
+	}
+
+	// Size of everything before the sample data; float files carry the extended fmt chunk and a fact chunk
+	static size_t HeaderSize(SampleFormat sampleFormat)
+	{
+		return sampleFormat == SampleFormat::Float32 ? 12 + 8 + 18 + 8 + 4 + 8 : 12 + 8 + 16 + 8;
+	}
+
+	bool IsWav(const uint8_t *file, size_t fileSize)
+	{
+		return fileSize >= 12 && !memcmp(file, "RIFF", 4) && !memcmp(file + 8, "WAVE", 4);
+	}
+
+	const char *Parse(const uint8_t *file, size_t fileSize, Info& outInfo)
+	{
+		if (!IsWav(file, fileSize))
+			return "Not a WAV file";
+
+		const uint8_t *fmt = nullptr;
+		uint32_t fmtSize = 0;
+		const uint8_t *data = nullptr;
+		size_t dataSize = 0;
+		for (size_t offset = 12; offset + 8 <= fileSize;)
+		{
+			const auto chunkData = file + offset + 8;
+			const auto chunkSize = ReadU32(file + offset + 4);
+			const auto availableSize = fileSize - offset - 8;
+			if (!memcmp(file + offset, "fmt ", 4))
+			{
+				fmt = chunkData;
+				fmtSize = static_cast<uint32_t>(min<size_t>(chunkSize, availableSize));
+			}
+			else if (!memcmp(file + offset, "data", 4))
+			{
+				// Streamed files may not have a valid data chunk size, so clamp it to what's actually there
+				data = chunkData;
+				dataSize = min<size_t>(chunkSize, availableSize);
+				break;
+			}
+			offset += 8 + static_cast<size_t>(chunkSize) + (chunkSize & 1);
+		}
+		if (!fmt || fmtSize < 16)
+			return "Missing or invalid fmt chunk";
+		if (!data)
+			return "Missing data chunk";
+
+		auto format = ReadU16(fmt);
+		const auto numChannels = ReadU16(fmt + 2);
+		const auto sampleRate = ReadU32(fmt + 4);
+		const auto blockAlign = ReadU16(fmt + 12);
+		const auto bitsPerSample = ReadU16(fmt + 14);
+		if (format == FormatExtensible)
+		{
+			// The actual format is given by the first two bytes of the subformat GUID
+			if (fmtSize < 40)
+				return "Invalid extensible fmt chunk";
+			format = ReadU16(fmt + 24);
+		}
+
+		if (format == FormatPcm && bitsPerSample == 16)
+			outInfo.sampleFormat = SampleFormat::Int16;
+		else if (format == FormatPcm && bitsPerSample == 24)
+			outInfo.sampleFormat = SampleFormat::Int24;
+		else if (format == FormatFloat && bitsPerSample == 32)
+			outInfo.sampleFormat = SampleFormat::Float32;
+		else
+			return "Unsupported sample format (only 16/24-bit integer and 32-bit float PCM are supported)";
+
+		if (!numChannels || blockAlign != numChannels * BytesPerSample(outInfo.sampleFormat))
+			return "Invalid channel count or block alignment";
+
+		outInfo.numChannels = numChannels;
+		outInfo.sampleRate = sampleRate;
+		outInfo.data = data;
+		outInfo.numFrames = static_cast<uint32_t>(dataSize / blockAlign);
+		return nullptr;
+	}
+
+	const float *MonoFloatSamples(const Info& info)
+	{
+		if (info.numChannels != 1 || info.sampleFormat != SampleFormat::Float32 || reinterpret_cast<uintptr_t>(info.data) % alignof(float))
+			return nullptr;
+		return reinterpret_cast<const float *>(info.data);
+	}
+
+	static float ReadSample(const uint8_t *p, SampleFormat sampleFormat)
+	{
+		switch (sampleFormat)
+		{
+		case SampleFormat::Int16:
+			return static_cast<float>(static_cast<int16_t>(ReadU16(p))) / 32768.0f;
+
+		case SampleFormat::Int24:
+			{
+				// Sign-extend by placing the sample in the top 24 bits
+				const auto sample = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+				return static_cast<float>(sample) / 8388608.0f;
+			}
+
+		default:
+			{
+				float sample;
+				memcpy(&sample, p, sizeof(sample));
+				return sample;
+			}
+		}
+	}
+
+	void ReadMono(const Info& info, float *out)
+	{
+		const auto bytesPerSample = BytesPerSample(info.sampleFormat);
+		const auto channelScale = 1.0f / static_cast<float>(info.numChannels);
+		auto p = info.data;
+		for (uint32_t i = 0; i < info.numFrames; i++)
+		{
+			auto sample = 0.0f;
+			for (uint32_t channel = 0; channel < info.numChannels; channel++)
+			{
+				sample += ReadSample(p, info.sampleFormat);
+				p += bytesPerSample;
+			}
+			out[i] = sample * channelScale;
+		}
+	}
+
+	size_t FileSize(uint32_t numSamples, SampleFormat sampleFormat)
+	{
+		return HeaderSize(sampleFormat) + static_cast<size_t>(numSamples) * BytesPerSample(sampleFormat);
+	}
+
+	void Write(uint8_t *out, const float *samples, uint32_t numSamples, uint32_t sampleRate, SampleFormat sampleFormat)
+	{
+		const auto bytesPerSample = BytesPerSample(sampleFormat);
+		const auto dataSize = numSamples * bytesPerSample;
+		const auto isFloat = sampleFormat == SampleFormat::Float32;
+
+		auto p = WriteTag(out, "RIFF");
+		p = WriteU32(p, static_cast<uint32_t>(FileSize(numSamples, sampleFormat) - 8));
+		p = WriteTag(p, "WAVE");
+
+		p = WriteTag(p, "fmt ");
+		p = WriteU32(p, isFloat ? 18 : 16);
+		p = WriteU16(p, isFloat ? FormatFloat : FormatPcm);
+		p = WriteU16(p, 1);
+		p = WriteU32(p, sampleRate);
+		p = WriteU32(p, sampleRate * bytesPerSample);
+		p = WriteU16(p, static_cast<uint16_t>(bytesPerSample));
+		p = WriteU16(p, static_cast<uint16_t>(bytesPerSample * 8));
+		if (isFloat)
+		{
+			p = WriteU16(p, 0);
+
+			p = WriteTag(p, "fact");
+			p = WriteU32(p, 4);
+			p = WriteU32(p, numSamples);
+		}
+
+		p = WriteTag(p, "data");
+		p = WriteU32(p, dataSize);
+
+		switch (sampleFormat)
+		{
+		case SampleFormat::Int16:
+			for (uint32_t i = 0; i < numSamples; i++)
+			{
+				const auto sample = lrintf(min(max(samples[i] * 32768.0f, -32768.0f), 32767.0f));
+				p = WriteU16(p, static_cast<uint16_t>(static_cast<int16_t>(sample)));
+			}
+			break;
+
+		case SampleFormat::Int24:
+			for (uint32_t i = 0; i < numSamples; i++)
+			{
+				const auto sample = static_cast<uint32_t>(lrintf(min(max(samples[i] * 8388608.0f, -8388608.0f), 8388607.0f)));
+				*p++ = static_cast<uint8_t>(sample);
+				*p++ = static_cast<uint8_t>(sample >> 8);
+				*p++ = static_cast<uint8_t>(sample >> 16);
+			}
+			break;
+
+		case SampleFormat::Float32:
+			memcpy(p, samples, dataSize);
+			break;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal reading and writing of PCM WAV files held in memory (eg. mapped with `MappedFile`)
+//  Only little-endian hosts are supported, like the rest of the demo.
+namespace Wav
+{
+	enum class SampleFormat
+	{
+		Int16,
+		Int24,
+		Float32,
+	};
+
+	struct Info
+	{
+		uint32_t numChannels;
+		uint32_t sampleRate;
+		SampleFormat sampleFormat;
+		// Interleaved sample data, pointing into the parsed file
+		const uint8_t *data;
+		// Number of sample frames (one sample per channel each)
+		uint32_t numFrames;
+	};
+
+	// Returns whether the given file contents look like a WAV file
+	bool IsWav(const uint8_t *file, size_t fileSize);
+
+	// Parses a WAV file's headers; returns null on success, or an error message otherwise
+	const char *Parse(const uint8_t *file, size_t fileSize, Info& outInfo);
+
+	// Returns the parsed file's samples directly if they're already mono 32-bit float (and suitably aligned), or null
+	const float *MonoFloatSamples(const Info& info);
+
+	// Converts the parsed file's samples to mono float samples (averaging all channels), writing `info.numFrames` samples
+	void ReadMono(const Info& info, float *out);
+
+	// Returns the size of a mono WAV file with the given number of samples and sample format
+	size_t FileSize(uint32_t numSamples, SampleFormat sampleFormat);
+
+	// Writes a mono WAV file (of exactly `FileSize(numSamples, sampleFormat)` bytes) to `out`, converting (and
+	//  saturating, for integer formats) the given float samples
+	void Write(uint8_t *out, const float *samples, uint32_t numSamples, uint32_t sampleRate, SampleFormat sampleFormat);
+}
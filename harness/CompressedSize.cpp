@@ -0,0 +1,33 @@
+#include "Metrics.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+using namespace std;
+
+// Prints the raw and LZMA-compressed sizes of the concatenation of one or more files, as "<raw> <lzma>"
+
+int main(int argc, const char **argv)
+{
+	if (argc < 2)
+	{
+		cout << "Usage: " << argv[0] << " <input file> [<input file> ...]\n";
+		return 1;
+	}
+
+	vector<uint8_t> input;
+	for (int i = 1; i < argc; i++)
+	{
+		ifstream inputFile(argv[i], ios::binary);
+		if (!inputFile)
+		{
+			cout << "ERROR: Couldn't read " << argv[i] << "\n";
+			return 1;
+		}
+		input.insert(input.end(), istreambuf_iterator<char>(inputFile), istreambuf_iterator<char>());
+	}
+
+	cout << input.size() << " " << Harness::LzmaCompressedSize(input) << "\n";
+	return 0;
+}
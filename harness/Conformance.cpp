@@ -0,0 +1,474 @@
+#include "HarnessShims.hpp"
+
+#include <Pulsejet/Pulsejet.hpp>
+
+#include "Corpus.hpp"
+#include "ReferenceDecoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks decoder implementations against the frozen reference decoder (see `ReferenceDecoder.hpp`) on a
+//  deterministic corpus of encoded streams, and benchmarks them side by side. The corpus consists of encoder
+//  output for the harness corpus, as well as synthetic streams exercising every window mode transition, sparse
+//  and noise-filled bands, extreme band energies and bins, and degenerate lengths, each in both stream layouts.
+//  The encoder's output in both layouts must contain the same frames.
+
+using Pulsejet::Internal::BandToNumBins;
+using Pulsejet::Internal::NumBands;
+using Pulsejet::Internal::NumSubframes;
+using Pulsejet::Internal::NumTotalBins;
+using Pulsejet::Internal::WindowMode;
+
+static const double SampleRate = 44100.0;
+static const double EncoderBitRates[] = { 8.0, 24.0, 64.0 };
+
+// Streams whose reference output peaks above this level (6 dB over full scale) are out of range for tolerance
+//  checks. Decoders with limited headroom can't represent them (and saturate differently), and the (float)
+//  reference itself loses precision relative to full scale when decoding them.
+static const float MaxInRangePeak = 2.0f;
+
+// A decoder implementation checked against the reference
+//  Decoders producing other sample formats are wrapped to produce normalized float samples. Deviations are
+//  measured after converting samples to 16 bits (scaling by 32768, rounding, and saturating).
+struct RegisteredDecoder
+{
+	const char *name;
+	float *(*decode)(const uint8_t *inputStream, uint32_t *outNumSamples);
+	// If set, the decoder must produce exactly the same samples as the reference for every stream
+	bool requireBitExact;
+	// Maximum allowed deviation from the reference, in 16-bit LSBs
+	uint32_t maxDeviation;
+};
+
+static float *DecodeFixedAsFloat(const uint8_t *inputStream, uint32_t *outNumSamples)
+{
+	const auto fixedSamples = Pulsejet::DecodeFixed(inputStream, outNumSamples);
+	const auto samples = new float[*outNumSamples];
+	for (uint32_t i = 0; i < *outNumSamples; i++)
+		samples[i] = static_cast<float>(fixedSamples[i]) / 32768.0f;
+	delete [] fixedSamples;
+	return samples;
+}
+
+// New decoder implementations should be registered here
+static const RegisteredDecoder Decoders[] =
+{
+	{ "Decode", Pulsejet::Decode, true, 0 },
+	{ "DecodeFixed", DecodeFixedAsFloat, false, 8 },
+};
+
+struct ConformanceStream
+{
+	string name;
+	vector<uint8_t> data;
+};
+
+// Decoded (but not yet serialized) stream contents, with band energies stored as absolute quantized values
+struct StreamFrame
+{
+	WindowMode windowMode;
+	vector<int8_t> bins;
+	vector<uint8_t> quantizedBandEnergies;
+};
+
+class Lcg
+{
+public:
+	uint32_t Next()
+	{
+		state = state * 1664525 + 1013904223;
+		return state >> 8;
+	}
+
+	int32_t Range(int32_t min, int32_t max)
+	{
+		return min + static_cast<int32_t>(Next() % static_cast<uint32_t>(max - min + 1));
+	}
+
+private:
+	uint32_t state = 1;
+};
+
+static StreamFrame MakeFrame(WindowMode windowMode)
+{
+	StreamFrame ret;
+	ret.windowMode = windowMode;
+	ret.bins.assign(NumTotalBins, 0);
+	ret.quantizedBandEnergies.assign(NumSubframes(windowMode) * NumBands, 0);
+	return ret;
+}
+
+// Serializes frames (including the extra frame the decoder decodes but doesn't output) in the given layout
+static vector<uint8_t> WriteStream(const vector<StreamFrame>& frames, Pulsejet::StreamLayout layout)
+{
+	vector<uint8_t> ret = { 'P', 'L', 'S', 'J', 0, 0, 0, 0 };
+	const auto version = reinterpret_cast<uint16_t *>(ret.data() + 4);
+	version[0] = Pulsejet::Internal::CodecVersionMajor;
+	version[1] = Pulsejet::Internal::CodecVersionMinor;
+
+	auto numFramesField = static_cast<uint16_t>(frames.size() - 1);
+	if (layout == Pulsejet::StreamLayout::Interleaved)
+		numFramesField |= Pulsejet::Internal::InterleavedLayoutFlag;
+	ret.push_back(static_cast<uint8_t>(numFramesField));
+	ret.push_back(static_cast<uint8_t>(numFramesField >> 8));
+
+	// Convert band energies to residuals
+	vector<vector<uint8_t>> bandEnergyResiduals;
+	uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+	for (const auto& frame : frames)
+	{
+		vector<uint8_t> residuals;
+		for (size_t i = 0; i < frame.quantizedBandEnergies.size(); i++)
+		{
+			const auto bandIndex = i % NumBands;
+			residuals.push_back(static_cast<uint8_t>(frame.quantizedBandEnergies[i] - quantizedBandEnergyPredictions[bandIndex]));
+			quantizedBandEnergyPredictions[bandIndex] = frame.quantizedBandEnergies[i];
+		}
+		bandEnergyResiduals.push_back(residuals);
+	}
+
+	if (layout == Pulsejet::StreamLayout::Interleaved)
+	{
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			ret.push_back(static_cast<uint8_t>(frames[i].windowMode));
+			ret.insert(ret.end(), frames[i].bins.begin(), frames[i].bins.end());
+			ret.insert(ret.end(), bandEnergyResiduals[i].begin(), bandEnergyResiduals[i].end());
+		}
+	}
+	else
+	{
+		for (const auto& frame : frames)
+			ret.push_back(static_cast<uint8_t>(frame.windowMode));
+		for (const auto& frame : frames)
+			ret.insert(ret.end(), frame.bins.begin(), frame.bins.end());
+		for (const auto& residuals : bandEnergyResiduals)
+			ret.insert(ret.end(), residuals.begin(), residuals.end());
+	}
+
+	return ret;
+}
+
+// Parses a stream in the concatenated layout (as produced by the encoder by default) back into frames
+static vector<StreamFrame> ReadStream(const vector<uint8_t>& stream)
+{
+	const auto numFrames = static_cast<uint32_t>(stream[8] | (stream[9] << 8)) + 1;
+	auto windowModeStream = stream.data() + 10;
+	auto binQStream = reinterpret_cast<const int8_t *>(windowModeStream + numFrames);
+	auto bandEnergyStream = windowModeStream + numFrames * (1 + NumTotalBins);
+
+	vector<StreamFrame> ret;
+	uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+	for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+	{
+		auto frame = MakeFrame(static_cast<WindowMode>(*windowModeStream++));
+		memcpy(frame.bins.data(), binQStream, NumTotalBins);
+		binQStream += NumTotalBins;
+		for (size_t i = 0; i < frame.quantizedBandEnergies.size(); i++)
+		{
+			const auto bandIndex = i % NumBands;
+			quantizedBandEnergyPredictions[bandIndex] += *bandEnergyStream++;
+			frame.quantizedBandEnergies[i] = quantizedBandEnergyPredictions[bandIndex];
+		}
+		ret.push_back(frame);
+	}
+	return ret;
+}
+
+// Fills a frame's bins with random values in [-maxBin, maxBin], with roughly the given fraction of nonzero bins
+static void FillBins(StreamFrame& frame, Lcg& lcg, int32_t maxBin, uint32_t densityPercent)
+{
+	for (auto& bin : frame.bins)
+	{
+		bin = 0;
+		if (lcg.Next() % 100 < densityPercent)
+		{
+			const auto magnitude = lcg.Range(1, maxBin);
+			bin = static_cast<int8_t>(lcg.Next() & 1 ? -magnitude : magnitude);
+		}
+	}
+}
+
+static void FillBandEnergies(StreamFrame& frame, Lcg& lcg, int32_t min, int32_t max)
+{
+	for (auto& quantizedBandEnergy : frame.quantizedBandEnergies)
+		quantizedBandEnergy = static_cast<uint8_t>(lcg.Range(min, max));
+}
+
+// Adds a stream (given as frames) in both layouts, named accordingly
+static void AddStreamInBothLayouts(vector<ConformanceStream>& streams, const string& name, const vector<StreamFrame>& frames)
+{
+	streams.push_back({ name + "/concatenated", WriteStream(frames, Pulsejet::StreamLayout::Concatenated) });
+	streams.push_back({ name + "/interleaved", WriteStream(frames, Pulsejet::StreamLayout::Interleaved) });
+}
+
+static void AddSyntheticStreams(vector<ConformanceStream>& streams)
+{
+	Lcg lcg;
+
+	// Every ordered pair of window modes, in a de Bruijn sequence (transitions the encoder never produces
+	//  are included as well, as the decoder must handle them the same way regardless)
+	{
+		const uint8_t windowModes[] = { 0, 0, 1, 0, 2, 0, 3, 1, 1, 2, 1, 3, 2, 2, 3, 3, 0 };
+		vector<StreamFrame> frames;
+		for (auto windowMode : windowModes)
+		{
+			auto frame = MakeFrame(static_cast<WindowMode>(windowMode));
+			FillBins(frame, lcg, 8, 30);
+			FillBandEnergies(frame, lcg, 20, 32);
+			frames.push_back(frame);
+		}
+		AddStreamInBothLayouts(streams, "transitions", frames);
+	}
+
+	// Bands with no nonzero bins, a single nonzero bin, and just below and at the noise fill threshold (10%)
+	{
+		const WindowMode windowModes[] = { WindowMode::Long, WindowMode::Start, WindowMode::Short, WindowMode::Stop, WindowMode::Long };
+		vector<StreamFrame> frames;
+		for (uint32_t frameIndex = 0; frameIndex < 8; frameIndex++)
+		{
+			const auto windowMode = windowModes[frameIndex % 5];
+			const auto numSubframes = NumSubframes(windowMode);
+			auto frame = MakeFrame(windowMode);
+			auto bandBins = frame.bins.data();
+			for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
+			for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+			{
+				const auto numBins = BandToNumBins[bandIndex] / numSubframes;
+				const auto numThresholdBins = (numBins + 9) / 10;
+				const uint32_t numNonzeroBinsOptions[] = { 0, 1, numThresholdBins - 1, numThresholdBins };
+				const auto numNonzeroBins = min(numNonzeroBinsOptions[(bandIndex + subframeIndex + frameIndex) % 4], numBins);
+				for (uint32_t i = 0; i < numNonzeroBins; i++)
+					bandBins[(i * 7 + frameIndex) % numBins] = static_cast<int8_t>(lcg.Range(-3, 3) | 1);
+				bandBins += numBins;
+			}
+			FillBandEnergies(frame, lcg, 8, 32);
+			frames.push_back(frame);
+		}
+		AddStreamInBothLayouts(streams, "sparse", frames);
+	}
+
+	// Extreme band energies: minimum, maximum, and alternating between both (which also exercises residual
+	//  wraparound), with dense, sparse, and empty bands
+	{
+		const WindowMode windowModes[] = { WindowMode::Long, WindowMode::Start, WindowMode::Short, WindowMode::Stop };
+		const pair<const char *, uint32_t> variants[] = { { "energy-min", 0 }, { "energy-max", 1 }, { "energy-alternating", 2 } };
+		for (const auto& variant : variants)
+		{
+			vector<StreamFrame> frames;
+			for (uint32_t frameIndex = 0; frameIndex < 9; frameIndex++)
+			{
+				auto frame = MakeFrame(windowModes[frameIndex % 4]);
+				FillBins(frame, lcg, 127, frameIndex % 3 == 0 ? 0 : frameIndex % 3 == 1 ? 5 : 90);
+				for (size_t i = 0; i < frame.quantizedBandEnergies.size(); i++)
+				{
+					const auto isMax = variant.second == 2 ? (i + frameIndex) % 2 == 1 : variant.second == 1;
+					frame.quantizedBandEnergies[i] = isMax ? 64 : 0;
+				}
+				frames.push_back(frame);
+			}
+			AddStreamInBothLayouts(streams, variant.first, frames);
+		}
+	}
+
+	// Full-scale bins in every band
+	{
+		vector<StreamFrame> frames;
+		for (uint32_t frameIndex = 0; frameIndex < 6; frameIndex++)
+		{
+			auto frame = MakeFrame(frameIndex == 2 ? WindowMode::Start : frameIndex == 3 ? WindowMode::Short : frameIndex == 4 ? WindowMode::Stop : WindowMode::Long);
+			for (auto& bin : frame.bins)
+				bin = static_cast<int8_t>(lcg.Next() & 1 ? -128 : 127);
+			FillBandEnergies(frame, lcg, 20, 28);
+			frames.push_back(frame);
+		}
+		AddStreamInBothLayouts(streams, "bins-full-scale", frames);
+	}
+
+	// Silence (all bands noise-filled at the minimum energy), and an empty stream (no output frames)
+	{
+		vector<StreamFrame> frames(4, MakeFrame(WindowMode::Long));
+		AddStreamInBothLayouts(streams, "silence", frames);
+		AddStreamInBothLayouts(streams, "empty", { MakeFrame(WindowMode::Short) });
+	}
+}
+
+// Adds encoder output for the harness corpus in both layouts
+//  Returns false if the encoder output isn't recognized by the meta API, can't be parsed and rewritten as-is, or if
+//  the encoder's interleaved output doesn't contain the same frames as its concatenated output.
+static bool AddEncoderStreams(vector<ConformanceStream>& streams)
+{
+	for (const auto& corpusSample : Harness::GenerateCorpus())
+	for (auto bitRate : EncoderBitRates)
+	{
+		const auto name = corpusSample.name + "@" + to_string(static_cast<uint32_t>(bitRate));
+		double totalBitsEstimate;
+		const auto encodedSample = Pulsejet::Encode(corpusSample.samples.data(), static_cast<uint32_t>(corpusSample.samples.size()), SampleRate, bitRate, totalBitsEstimate);
+		if (!Pulsejet::CheckSample(encodedSample.data()) || !Pulsejet::CheckSampleVersion(encodedSample.data()))
+		{
+			cout << "ERROR: Encoder output for " << name << " isn't recognized as a compatible sample\n";
+			return false;
+		}
+		const auto frames = ReadStream(encodedSample);
+		if (WriteStream(frames, Pulsejet::StreamLayout::Concatenated) != encodedSample)
+		{
+			cout << "ERROR: Couldn't parse encoder output for " << name << "\n";
+			return false;
+		}
+
+		Pulsejet::EncodeOptions options;
+		options.layout = Pulsejet::StreamLayout::Interleaved;
+		const auto interleavedEncodedSample = Pulsejet::Encode(corpusSample.samples.data(), static_cast<uint32_t>(corpusSample.samples.size()), SampleRate, bitRate, totalBitsEstimate, options);
+		if (Pulsejet::SampleLayout(interleavedEncodedSample.data()) != Pulsejet::StreamLayout::Interleaved || WriteStream(frames, Pulsejet::StreamLayout::Interleaved) != interleavedEncodedSample)
+		{
+			cout << "ERROR: Interleaved encoder output doesn't match concatenated encoder output for " << name << "\n";
+			return false;
+		}
+
+		streams.push_back({ name + "/concatenated", encodedSample });
+		streams.push_back({ name + "/interleaved", interleavedEncodedSample });
+	}
+	return true;
+}
+
+static int32_t ToInt16(float sample)
+{
+	return static_cast<int32_t>(lrint(min(max(static_cast<double>(sample) * 32768.0, -32768.0), 32767.0)));
+}
+
+// Decodes a stream, measuring the time taken (in ms)
+static vector<float> TimedDecode(float *(*decode)(const uint8_t *, uint32_t *), const ConformanceStream& stream, double& inOutTime)
+{
+	uint32_t numSamples;
+	const auto start = chrono::steady_clock::now();
+	const auto samples = decode(stream.data.data(), &numSamples);
+	inOutTime += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	vector<float> ret(samples, samples + numSamples);
+	delete [] samples;
+	return ret;
+}
+
+int main()
+{
+#ifdef PULSEJET_HARNESS_BATCH_SHIMS
+	cout << "Using batch shims\n";
+#endif
+#ifdef PULSEJET_IMDCT_COSINE_TABLES
+	cout << "Using IMDCT cosine tables\n";
+#endif
+#ifdef PULSEJET_NO_SPECIALIZED_DECODE_KERNELS
+	cout << "Using the generic decode kernel\n";
+#endif
+	cout << "\n";
+
+	vector<ConformanceStream> streams;
+	AddSyntheticStreams(streams);
+	if (!AddEncoderStreams(streams))
+		return 1;
+
+	// Decode all streams with the reference, and determine which are in range for tolerance checks
+	double referenceTime = 0.0;
+	vector<vector<float>> referenceOutputs;
+	vector<bool> isInRange;
+	uint32_t numInRangeStreams = 0;
+	for (const auto& stream : streams)
+	{
+		referenceOutputs.push_back(TimedDecode(Harness::ReferenceDecode, stream, referenceTime));
+		auto peak = 0.0f;
+		for (auto sample : referenceOutputs.back())
+			peak = max(peak, abs(sample));
+		isInRange.push_back(peak <= MaxInRangePeak);
+		if (isInRange.back())
+			numInRangeStreams++;
+	}
+
+	// Both layouts of the same stream must decode identically
+	auto ok = true;
+	for (size_t i = 0; i + 1 < streams.size(); i += 2)
+	{
+		if (referenceOutputs[i] != referenceOutputs[i + 1])
+		{
+			cout << "FAILED: reference output differs between layouts for " << streams[i].name << "\n";
+			ok = false;
+		}
+	}
+
+	cout << streams.size() << " stream(s), " << numInRangeStreams << " in range for tolerance checks\n";
+	cout << left << setw(16) << "decoder" << right
+		<< setw(12) << "bit-exact" << setw(16) << "max deviation" << "  "
+		<< left << setw(32) << "worst stream" << right
+		<< setw(12) << "time (ms)" << setw(10) << "speedup" << "\n";
+	cout << left << setw(16) << "reference" << right
+		<< setw(12) << "-" << setw(16) << "-" << "  "
+		<< left << setw(32) << "-" << right
+		<< setw(12) << fixed << setprecision(1) << referenceTime << setw(9) << setprecision(2) << 1.0 << "x\n";
+
+	for (const auto& decoder : Decoders)
+	{
+		double time = 0.0;
+		uint32_t numBitExactStreams = 0;
+		uint32_t maxDeviation = 0;
+		string worstStreamName = "-";
+		for (size_t i = 0; i < streams.size(); i++)
+		{
+			const auto& reference = referenceOutputs[i];
+			const auto samples = TimedDecode(decoder.decode, streams[i], time);
+			if (samples.size() != reference.size())
+			{
+				cout << "FAILED: " << decoder.name << " decodes " << samples.size() << " sample(s) instead of " << reference.size() << " for " << streams[i].name << "\n";
+				ok = false;
+				continue;
+			}
+
+			if (!memcmp(samples.data(), reference.data(), samples.size() * sizeof(float)))
+			{
+				numBitExactStreams++;
+			}
+			else if (decoder.requireBitExact)
+			{
+				cout << "FAILED: " << decoder.name << " is not bit-exact for " << streams[i].name << "\n";
+				ok = false;
+			}
+
+			if (!isInRange[i])
+				continue;
+			for (size_t j = 0; j < samples.size(); j++)
+			{
+				const auto deviation = static_cast<uint32_t>(abs(ToInt16(samples[j]) - ToInt16(reference[j])));
+				if (deviation > maxDeviation)
+				{
+					maxDeviation = deviation;
+					worstStreamName = streams[i].name;
+				}
+			}
+		}
+		if (maxDeviation > decoder.maxDeviation)
+		{
+			cout << "FAILED: " << decoder.name << " deviates by " << maxDeviation << " LSB(s) (at most " << decoder.maxDeviation << " allowed)\n";
+			ok = false;
+		}
+
+		cout << left << setw(16) << decoder.name << right
+			<< setw(12) << (to_string(numBitExactStreams) + "/" + to_string(streams.size())) << setw(16) << (to_string(maxDeviation) + " LSB(s)") << "  "
+			<< left << setw(32) << worstStreamName << right
+			<< setw(12) << setprecision(1) << time << setw(9) << setprecision(2) << referenceTime / time << "x\n";
+	}
+
+	if (!ok)
+	{
+		cout << "conformance check FAILED\n";
+		return 1;
+	}
+	cout << "conformance check passed\n";
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include "Corpus.hpp"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+namespace Harness
+{
+	static const double SampleRate = 44100.0;
+	static const uint32_t NumSamples = 22050;
+
+	class Lcg
+	{
+	public:
+		float Next()
+		{
+			// Numerical Recipes parameters, same as the decoder's noise fill
+			state = state * 1664525 + 1013904223;
+			return static_cast<float>(static_cast<int32_t>(state)) / 2147483648.0f;
+		}
+
+	private:
+		uint32_t state = 1;
+	};
+
+	static vector<float> Tone()
+	{
+		// Harmonic tone with slow vibrato
+		vector<float> ret(NumSamples);
+		double phase = 0.0;
+		for (uint32_t i = 0; i < NumSamples; i++)
+		{
+			const auto t = static_cast<double>(i) / SampleRate;
+			phase += 2.0 * M_PI * 220.0 * (1.0 + 0.01 * sin(2.0 * M_PI * 5.0 * t)) / SampleRate;
+			double sample = 0.0;
+			for (uint32_t harmonic = 1; harmonic <= 8; harmonic++)
+				sample += sin(phase * static_cast<double>(harmonic)) / static_cast<double>(harmonic);
+			ret[i] = static_cast<float>(sample * 0.3);
+		}
+		return ret;
+	}
+
+	static vector<float> Chord()
+	{
+		// Decaying plucked chord
+		const double freqs[] = { 130.81, 164.81, 196.0, 261.63, 329.63 };
+		vector<float> ret(NumSamples);
+		for (uint32_t i = 0; i < NumSamples; i++)
+		{
+			const auto t = static_cast<double>(i) / SampleRate;
+			double sample = 0.0;
+			for (auto freq : freqs)
+				sample += sin(2.0 * M_PI * freq * t) * exp(-t * freq / 100.0);
+			ret[i] = static_cast<float>(sample * 0.2);
+		}
+		return ret;
+	}
+
+	static vector<float> Noise()
+	{
+		// One-pole lowpassed noise with a slow amplitude swell
+		Lcg lcg;
+		vector<float> ret(NumSamples);
+		float state = 0.0f;
+		for (uint32_t i = 0; i < NumSamples; i++)
+		{
+			state += (lcg.Next() - state) * 0.3f;
+			const auto swell = static_cast<float>(i) / static_cast<float>(NumSamples);
+			ret[i] = state * (0.2f + 0.6f * swell);
+		}
+		return ret;
+	}
+
+	static vector<float> Drums()
+	{
+		// Kick/hat pattern, exercising transient detection and short windows
+		Lcg lcg;
+		vector<float> ret(NumSamples);
+		const uint32_t stepSize = NumSamples / 8;
+		for (uint32_t i = 0; i < NumSamples; i++)
+		{
+			const auto step = i / stepSize;
+			const auto t = static_cast<double>(i % stepSize) / SampleRate;
+			double sample = 0.0;
+			if (step % 4 == 0)
+				sample += sin(2.0 * M_PI * (50.0 * t + 150.0 * (1.0 - exp(-t * 30.0)) / 30.0)) * exp(-t * 12.0);
+			sample += lcg.Next() * exp(-t * (step % 2 ? 40.0 : 90.0)) * 0.5;
+			ret[i] = static_cast<float>(sample * 0.7);
+		}
+		return ret;
+	}
+
+	static vector<float> Sparse()
+	{
+		// Mostly silence with isolated blips, exercising noise fill and very low band energies
+		vector<float> ret(NumSamples, 0.0f);
+		for (uint32_t blip = 0; blip < 3; blip++)
+		{
+			const auto offset = 3000 + blip * 7000;
+			for (uint32_t i = 0; i < 2000; i++)
+			{
+				const auto t = static_cast<double>(i) / SampleRate;
+				ret[offset + i] = static_cast<float>(sin(2.0 * M_PI * 3000.0 * t) * exp(-t * 200.0) * 0.5);
+			}
+		}
+		return ret;
+	}
+
+	vector<CorpusSample> GenerateCorpus()
+	{
+		return
+		{
+			{ "tone", Tone() },
+			{ "chord", Chord() },
+			{ "noise", Noise() },
+			{ "drums", Drums() },
+			{ "sparse", Sparse() },
+		};
+	}
+}
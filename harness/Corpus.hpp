@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Harness
+{
+	struct CorpusSample
+	{
+		std::string name;
+		std::vector<float> samples;
+	};
+
+	// Generates a small, fully deterministic corpus of synthetic 44100hz mono samples
+	//  covering tonal, noisy, transient, and sparse material
+	std::vector<CorpusSample> GenerateCorpus();
+}
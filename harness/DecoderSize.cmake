@@ -0,0 +1,120 @@
+# Measures decoder code size for each build profile and compares it against a stored baseline.
+#
+# Expected variables:
+#  OBJCOPY: path to objcopy
+#  OBJDUMP: path to objdump
+#  COMPRESSED_SIZE: path to the pulsejet_compressed_size tool
+#  PROFILES: comma-separated list of profile names
+#  OBJECTS: comma-separated list of object files, one per profile (same order as PROFILES)
+#  WORK_DIR: directory for intermediate files
+#  BASELINE: baseline file path
+#  UPDATE: if true, the baseline is rewritten instead of compared against
+
+# Allowed deviation from the baseline, in either direction, before the check fails
+set(TOLERANCE_PERCENT 1)
+set(TOLERANCE_MIN_BYTES 8)
+
+function(check_size profile metric size baseline_size out_ok)
+	math(EXPR delta "${size} - ${baseline_size}")
+	math(EXPR tolerance "${baseline_size} * ${TOLERANCE_PERCENT} / 100")
+	if(tolerance LESS TOLERANCE_MIN_BYTES)
+		set(tolerance ${TOLERANCE_MIN_BYTES})
+	endif()
+	set(abs_delta ${delta})
+	if(abs_delta LESS 0)
+		math(EXPR abs_delta "-${delta}")
+	endif()
+	if(abs_delta GREATER tolerance)
+		message("CHANGED: ${profile} ${metric} ${baseline_size} -> ${size} bytes (${delta}); update the baseline if this is intended")
+		set(${out_ok} FALSE PARENT_SCOPE)
+	endif()
+endfunction()
+
+string(REPLACE "," ";" PROFILES "${PROFILES}")
+string(REPLACE "," ";" OBJECTS "${OBJECTS}")
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(report "# profile textSize lzmaSize\n")
+list(LENGTH PROFILES num_profiles)
+math(EXPR last_profile_index "${num_profiles} - 1")
+foreach(profile_index RANGE ${last_profile_index})
+	list(GET PROFILES ${profile_index} profile)
+	list(GET OBJECTS ${profile_index} object)
+
+	# Code may be spread over several sections (eg. one per template instantiation), so gather all .text* sections
+	execute_process(
+		COMMAND ${OBJDUMP} -h ${object}
+		OUTPUT_VARIABLE section_headers
+		RESULT_VARIABLE result)
+	if(result)
+		message(FATAL_ERROR "objdump failed for ${object}")
+	endif()
+	string(REGEX MATCHALL "[0-9]+ (\\.text[^ \n]*)" text_sections "${section_headers}")
+	set(text_files)
+	set(section_index 0)
+	foreach(text_section ${text_sections})
+		string(REGEX REPLACE "^[0-9]+ " "" text_section "${text_section}")
+		set(text_file ${WORK_DIR}/${profile}.text.${section_index}.bin)
+		execute_process(
+			COMMAND ${OBJCOPY} -O binary --only-section=${text_section} ${object} ${text_file}
+			RESULT_VARIABLE result)
+		if(result)
+			message(FATAL_ERROR "objcopy failed for ${object}")
+		endif()
+		list(APPEND text_files ${text_file})
+		math(EXPR section_index "${section_index} + 1")
+	endforeach()
+
+	execute_process(
+		COMMAND ${COMPRESSED_SIZE} ${text_files}
+		OUTPUT_VARIABLE sizes
+		RESULT_VARIABLE result
+		OUTPUT_STRIP_TRAILING_WHITESPACE)
+	if(result)
+		message(FATAL_ERROR "pulsejet_compressed_size failed for ${object}")
+	endif()
+	string(REPLACE " " ";" sizes "${sizes}")
+	list(GET sizes 0 text_size)
+	list(GET sizes 1 lzma_size)
+
+	message("decoder size (${profile}): .text ${text_size} bytes, lzma ${lzma_size} bytes")
+	string(APPEND report "${profile} ${text_size} ${lzma_size}\n")
+	set(measured_${profile}_text ${text_size})
+	set(measured_${profile}_lzma ${lzma_size})
+endforeach()
+
+if(UPDATE)
+	file(WRITE ${BASELINE} "${report}")
+	message("baseline updated: ${BASELINE}")
+	return()
+endif()
+
+if(NOT EXISTS ${BASELINE})
+	message(FATAL_ERROR "missing baseline ${BASELINE}")
+endif()
+file(STRINGS ${BASELINE} baseline_lines REGEX "^[^#]")
+set(ok TRUE)
+foreach(profile ${PROFILES})
+	set(found FALSE)
+	foreach(line ${baseline_lines})
+		string(REPLACE " " ";" fields "${line}")
+		list(GET fields 0 baseline_profile)
+		if(baseline_profile STREQUAL profile)
+			list(GET fields 1 baseline_text)
+			list(GET fields 2 baseline_lzma)
+			check_size(${profile} .text ${measured_${profile}_text} ${baseline_text} ok)
+			check_size(${profile} lzma ${measured_${profile}_lzma} ${baseline_lzma} ok)
+			set(found TRUE)
+		endif()
+	endforeach()
+	if(NOT found)
+		message("MISSING: ${profile} has no baseline")
+		set(ok FALSE)
+	endif()
+endforeach()
+
+if(NOT ok)
+	message(FATAL_ERROR "decoder size check FAILED")
+endif()
+message("decoder size check passed")
@@ -0,0 +1,46 @@
+// Minimal translation unit containing only `Pulsejet::Decode`, used to measure the decoder's
+//  code size the way it would be built into a size-constrained executable.
+//
+// In the size profile, support for the interleaved stream layout is compiled out (see
+//  `PULSEJET_NO_INTERLEAVED_LAYOUT`), as size-constrained executables embed concatenated samples,
+//  and a single generic kernel decodes all frames (see `PULSEJET_NO_SPECIALIZED_DECODE_KERNELS`).
+//
+// In the fixed profile, `Pulsejet::DecodeFixed` is measured instead, which doesn't use any shims.
+//
+// The shims are only declared here, as their implementations are user-provided and shouldn't
+//  count towards the decoder's size. In the speed profile, batch shims are declared as well,
+//  enabling the decoder's speed-oriented code paths, and IMDCT cosine tables are enabled (see
+//  `PULSEJET_IMDCT_COSINE_TABLES`).
+
+#include <cstdint>
+
+#ifdef PULSEJET_DECODER_SIZE_FIXED_PROFILE
+#include <Pulsejet/DecodeFixed.hpp>
+
+extern "C" int16_t *PulsejetDecodeFixed(const uint8_t *inputStream, uint32_t *outNumSamples)
+{
+	return Pulsejet::DecodeFixed(inputStream, outNumSamples);
+}
+#else
+namespace Pulsejet::Shims
+{
+	float CosF(float x);
+	float Exp2f(float x);
+	float SinF(float x);
+	float SqrtF(float x);
+
+#ifdef PULSEJET_DECODER_SIZE_SPEED_PROFILE
+	void CosF(const float *x, float *out, uint32_t n);
+	void Exp2f(const float *x, float *out, uint32_t n);
+	void SinF(const float *x, float *out, uint32_t n);
+	void SqrtF(const float *x, float *out, uint32_t n);
+#endif
+}
+
+#include <Pulsejet/Decode.hpp>
+
+extern "C" float *PulsejetDecode(const uint8_t *inputStream, uint32_t *outNumSamples)
+{
+	return Pulsejet::Decode(inputStream, outNumSamples);
+}
+#endif
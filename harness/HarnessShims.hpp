@@ -0,0 +1,59 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdint>
+
+// Harness tools use plain libm shims so that their results are reproducible
+//  and independent of any speed-optimized shim implementations
+//  If `PULSEJET_HARNESS_BATCH_SHIMS` is defined, batch overloads (evaluating the same
+//  functions per element) are provided as well, which enables the library's batch-only
+//  code paths without changing any results they're expected to reproduce.
+namespace Pulsejet::Shims
+{
+	inline float CosF(float x)
+	{
+		return cosf(x);
+	}
+
+	inline float Exp2f(float x)
+	{
+		return exp2f(x);
+	}
+
+	inline float SinF(float x)
+	{
+		return sinf(x);
+	}
+
+	inline float SqrtF(float x)
+	{
+		return sqrtf(x);
+	}
+
+#ifdef PULSEJET_HARNESS_BATCH_SHIMS
+	inline void CosF(const float *x, float *out, uint32_t n)
+	{
+		for (uint32_t i = 0; i < n; i++)
+			out[i] = cosf(x[i]);
+	}
+
+	inline void Exp2f(const float *x, float *out, uint32_t n)
+	{
+		for (uint32_t i = 0; i < n; i++)
+			out[i] = exp2f(x[i]);
+	}
+
+	inline void SinF(const float *x, float *out, uint32_t n)
+	{
+		for (uint32_t i = 0; i < n; i++)
+			out[i] = sinf(x[i]);
+	}
+
+	inline void SqrtF(const float *x, float *out, uint32_t n)
+	{
+		for (uint32_t i = 0; i < n; i++)
+			out[i] = sqrtf(x[i]);
+	}
+#endif
+}
@@ -0,0 +1,210 @@
+#include "Metrics.hpp"
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+#include <lzma.h>
+#include <zlib.h>
+
+using namespace std;
+
+namespace Harness
+{
+	static const uint32_t SpectrumSize = 2048;
+	static const uint32_t SpectrumHopSize = SpectrumSize / 2;
+	static const double MaskOffsetDb = 12.0;
+
+	// Half width of the lowpass filter used for decimation, in reduced-rate samples
+	static const double LowpassHalfWidth = 32.0;
+
+	// Power floor for log-domain comparisons (roughly -90dB relative to a full scale sinusoid)
+	static const double PowerFloor = 1e-4;
+
+	// Same band layout as the codec, as it maps directly onto a 1024-bin spectrum
+	static const uint32_t BandToNumBins[] =
+	{
+		8, 8, 8, 8, 8, 8, 8, 8, 16, 16, 24, 32, 32, 40, 48, 64, 80, 120, 144, 176,
+	};
+
+	static void Fft(vector<complex<double>>& x)
+	{
+		const auto n = static_cast<uint32_t>(x.size());
+
+		// Bit reversal permutation
+		for (uint32_t i = 1, j = 0; i < n; i++)
+		{
+			uint32_t bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				swap(x[i], x[j]);
+		}
+
+		// Radix-2 butterflies
+		for (uint32_t length = 2; length <= n; length <<= 1)
+		{
+			const auto angle = -2.0 * M_PI / static_cast<double>(length);
+			const complex<double> step(cos(angle), sin(angle));
+			for (uint32_t i = 0; i < n; i += length)
+			{
+				complex<double> w(1.0, 0.0);
+				for (uint32_t j = 0; j < length / 2; j++)
+				{
+					const auto u = x[i + j];
+					const auto v = x[i + j + length / 2] * w;
+					x[i + j] = u + v;
+					x[i + j + length / 2] = u - v;
+					w *= step;
+				}
+			}
+		}
+	}
+
+	static vector<double> PowerSpectrum(const float *samples, uint32_t numSamples, uint32_t offset)
+	{
+		vector<complex<double>> bins(SpectrumSize);
+		for (uint32_t i = 0; i < SpectrumSize; i++)
+		{
+			const auto window = 0.5 - 0.5 * cos(2.0 * M_PI * (static_cast<double>(i) + 0.5) / static_cast<double>(SpectrumSize));
+			const auto sample = offset + i < numSamples ? static_cast<double>(samples[offset + i]) : 0.0;
+			bins[i] = sample * window;
+		}
+		Fft(bins);
+
+		vector<double> ret(SpectrumSize / 2);
+		for (uint32_t i = 0; i < SpectrumSize / 2; i++)
+			ret[i] = norm(bins[i]);
+		return ret;
+	}
+
+	QualityMetrics MeasureQuality(const float *reference, const float *decoded, uint32_t numSamples)
+	{
+		QualityMetrics ret;
+
+		// SNR
+		ret.snr = SignalToNoiseRatio(reference, decoded, numSamples);
+		vector<float> noise(numSamples);
+		for (uint32_t i = 0; i < numSamples; i++)
+			noise[i] = static_cast<float>(static_cast<double>(decoded[i]) - static_cast<double>(reference[i]));
+
+		// Spectral metrics over overlapping frames, limited to the codec's bandwidth
+		uint32_t numCodedBins = 0;
+		for (auto numBins : BandToNumBins)
+			numCodedBins += numBins;
+		double logSpectralDistanceSum = 0.0;
+		uint32_t numFrames = 0;
+		double noiseToMaskRatioSum = 0.0;
+		uint32_t numMaskedBands = 0;
+		for (uint32_t offset = 0; offset < numSamples; offset += SpectrumHopSize)
+		{
+			const auto referenceSpectrum = PowerSpectrum(reference, numSamples, offset);
+			const auto decodedSpectrum = PowerSpectrum(decoded, numSamples, offset);
+			const auto noiseSpectrum = PowerSpectrum(noise.data(), numSamples, offset);
+
+			double squaredDistanceSum = 0.0;
+			for (uint32_t i = 0; i < numCodedBins; i++)
+			{
+				const auto distance = 10.0 * log10((referenceSpectrum[i] + PowerFloor) / (decodedSpectrum[i] + PowerFloor));
+				squaredDistanceSum += distance * distance;
+			}
+			logSpectralDistanceSum += sqrt(squaredDistanceSum / static_cast<double>(numCodedBins));
+			numFrames++;
+
+			uint32_t bin = 0;
+			for (auto numBins : BandToNumBins)
+			{
+				double referenceBandEnergy = 0.0;
+				double noiseBandEnergy = 0.0;
+				for (uint32_t i = 0; i < numBins; i++, bin++)
+				{
+					referenceBandEnergy += referenceSpectrum[bin];
+					noiseBandEnergy += noiseSpectrum[bin];
+				}
+
+				// Skip (effectively) silent bands, which would otherwise dominate the mean
+				if (referenceBandEnergy < PowerFloor * static_cast<double>(numBins))
+					continue;
+
+				const auto maskEnergy = referenceBandEnergy * pow(10.0, -MaskOffsetDb / 10.0);
+				noiseToMaskRatioSum += 10.0 * log10((noiseBandEnergy + PowerFloor) / maskEnergy);
+				numMaskedBands++;
+			}
+		}
+		ret.logSpectralDistance = numFrames ? logSpectralDistanceSum / static_cast<double>(numFrames) : 0.0;
+		ret.noiseToMaskRatio = numMaskedBands ? noiseToMaskRatioSum / static_cast<double>(numMaskedBands) : 0.0;
+
+		return ret;
+	}
+
+	double SignalToNoiseRatio(const float *reference, const float *decoded, uint32_t numSamples)
+	{
+		double signalEnergy = 1e-20;
+		double noiseEnergy = 1e-20;
+		for (uint32_t i = 0; i < numSamples; i++)
+		{
+			const auto signal = static_cast<double>(reference[i]);
+			const auto error = static_cast<double>(decoded[i]) - signal;
+			signalEnergy += signal * signal;
+			noiseEnergy += error * error;
+		}
+		return 10.0 * log10(signalEnergy / noiseEnergy);
+	}
+
+	vector<float> BandLimitAndDecimate(const float *samples, uint32_t numSamples, uint32_t rateShift)
+	{
+		// Blackman-windowed sinc lowpass, evaluated directly at each output sample's (fractional) position
+		const auto decimationFactor = static_cast<double>(1 << rateShift);
+		const auto cutoff = 0.5 / decimationFactor;
+		const auto halfWidth = LowpassHalfWidth * decimationFactor;
+
+		vector<float> ret(numSamples >> rateShift);
+		for (size_t n = 0; n < ret.size(); n++)
+		{
+			const auto position = (static_cast<double>(n) + 0.5) * decimationFactor - 0.5;
+			const auto first = static_cast<int64_t>(max(ceil(position - halfWidth), 0.0));
+			const auto last = static_cast<int64_t>(min(floor(position + halfWidth), static_cast<double>(numSamples) - 1.0));
+			double sum = 0.0;
+			for (auto i = first; i <= last; i++)
+			{
+				const auto t = static_cast<double>(i) - position;
+				const auto sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+				const auto window = 0.42 + 0.5 * cos(M_PI * t / halfWidth) + 0.08 * cos(2.0 * M_PI * t / halfWidth);
+				sum += static_cast<double>(samples[i]) * sinc * window;
+			}
+			ret[n] = static_cast<float>(sum);
+		}
+		return ret;
+	}
+
+	uint32_t ZlibCompressedSize(const vector<uint8_t>& data)
+	{
+		auto compressedSize = compressBound(static_cast<uLong>(data.size()));
+		vector<uint8_t> compressed(compressedSize);
+		if (compress2(compressed.data(), &compressedSize, data.data(), static_cast<uLong>(data.size()), Z_BEST_COMPRESSION) != Z_OK)
+			throw runtime_error("zlib compression failed");
+		return static_cast<uint32_t>(compressedSize);
+	}
+
+	uint32_t LzmaCompressedSize(const vector<uint8_t>& data)
+	{
+		// Raw LZMA1 stream (no container headers), which is closest to what executable packers do
+		lzma_options_lzma options;
+		if (lzma_lzma_preset(&options, 9 | LZMA_PRESET_EXTREME))
+			throw runtime_error("invalid lzma preset");
+		const lzma_filter filters[] =
+		{
+			{ LZMA_FILTER_LZMA1, &options },
+			{ LZMA_VLI_UNKNOWN, nullptr },
+		};
+
+		vector<uint8_t> compressed(data.size() + data.size() / 2 + 1024);
+		size_t compressedSize = 0;
+		if (lzma_raw_buffer_encode(filters, nullptr, data.data(), data.size(), compressed.data(), &compressedSize, compressed.size()) != LZMA_OK)
+			throw runtime_error("lzma compression failed");
+		return static_cast<uint32_t>(compressedSize);
+	}
+}
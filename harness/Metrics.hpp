@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Harness
+{
+	struct QualityMetrics
+	{
+		// Signal-to-noise ratio in dB (higher is better)
+		double snr;
+		// Mean log-spectral distance in dB (lower is better)
+		double logSpectralDistance;
+		// Mean noise-to-mask ratio in dB, using a crude per-band masking threshold
+		//  a fixed offset below the reference band energy (lower is better)
+		double noiseToMaskRatio;
+	};
+
+	// Compares decoded samples against the reference samples they were encoded from
+	QualityMetrics MeasureQuality(const float *reference, const float *decoded, uint32_t numSamples);
+
+	// Signal-to-noise ratio of decoded samples relative to reference samples, in dB
+	double SignalToNoiseRatio(const float *reference, const float *decoded, uint32_t numSamples);
+
+	// Band-limits samples to the Nyquist frequency of 44100hz >> `rateShift` and decimates them to that rate, sampling
+	//  the centers of the reduced-rate samples' spans (as `Pulsejet::DecodePreview` does)
+	std::vector<float> BandLimitAndDecimate(const float *samples, uint32_t numSamples, uint32_t rateShift);
+
+	// Compressed sizes in bytes of a byte stream using in-process general-purpose compressors
+	uint32_t ZlibCompressedSize(const std::vector<uint8_t>& data);
+	uint32_t LzmaCompressedSize(const std::vector<uint8_t>& data);
+}
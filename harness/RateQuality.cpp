@@ -0,0 +1,735 @@
+#include "HarnessShims.hpp"
+
+#include <Pulsejet/Pulsejet.hpp>
+
+#include "Corpus.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Runs the harness corpus through the encoder and decoder at several bit rates and with each
+//  bits estimator, measuring actual (raw and compressed) sizes, the size estimate error, and
+//  objective quality metrics, and compares the results against a stored baseline. The corpus
+//  is also encoded as a bank (see `EncodeBank`) with a few byte budgets, which must be met.
+//  Every encoded sample is additionally decoded with `DecodeFixed`, whose output must stay
+//  within its documented error bound of the (16-bit converted) `Decode` output, and each
+//  sample encoded with the (stateless) order 0 estimator is edited and re-encoded with
+//  `ReEncode`, which must reproduce a full encode of the edited sample when required to
+//  converge exactly, and otherwise (in both layouts) only change a bounded number of frames
+//  around the edit, at about the quality of a full encode. These samples are also decoded
+//  with `DecodePreview` at each reduced rate, which must stay close to the band-limited,
+//  decimated `Decode` output, and whose speedup over `Decode` is tracked in the baseline.
+
+static const double SampleRate = 44100.0;
+static const double TargetBitRates[] = { 8.0, 24.0, 64.0 };
+
+// Average bit rates for which the whole corpus is encoded as a bank with a corresponding byte budget
+static const double BankBitRates[] = { 12.0, 24.0 };
+
+// Allowed relative size deviations and absolute quality deviations (dB) before a result is
+//  considered a regression. These are loose enough to absorb libm differences across platforms.
+static const double SizeTolerance = 0.01;
+static const double QualityTolerance = 0.05;
+
+// Maximum allowed difference between `DecodeFixed` and `Decode` outputs, in 16-bit LSBs (see `DecodeFixed`)
+static const uint32_t FixedDecoderMaxDeviation = 8;
+
+// Edit applied to each sample for the `ReEncode` check: a 10ms gain change a quarter of the way into the sample, leaving
+//  enough frames after it to check that re-encoding with the default options leaves them untouched
+static const uint32_t ReEncodeEditSize = 441;
+static const float ReEncodeEditGain = 0.5f;
+
+// With the default convergence options, the SNR of `ReEncode`'s result may differ from a full encode's by at most this
+//  much (dB)
+static const double ReEncodeMaxSnrDifference = 0.5;
+
+// `DecodePreview` rate shifts to check, and the minimum SNR (dB) of their output relative to the band-limited,
+//  decimated `Decode` output
+static const uint32_t PreviewRateShifts[] = { 1, 2 };
+static const double PreviewMinSnr = 20.0;
+
+// Preview speedups are timed (best of a few runs), so they're noisy; only drops by more than this fraction of the
+//  baseline speedup are considered regressions
+static const uint32_t PreviewNumTimingRuns = 5;
+static const double PreviewSpeedupTolerance = 0.5;
+
+struct BankTotal
+{
+	double bitRate;
+	uint32_t byteBudget;
+	uint32_t lzmaSize;
+};
+
+struct ReEncodeTotal
+{
+	uint32_t numFailures;
+	uint32_t maxChangedFrames;
+	double maxSnrDifference;
+};
+
+struct Result
+{
+	string sampleName;
+	double targetBitRate;
+	string estimatorName;
+	uint32_t rawSize;
+	uint32_t zlibSize;
+	uint32_t lzmaSize;
+	uint32_t estimatedSize;
+	Harness::QualityMetrics quality;
+
+	// Size the encoder aimed for; derived from the target bit rate, so it isn't stored in baselines. Bank samples don't
+	//  have a target of their own, so it's 0 for them.
+	uint32_t targetSize = 0;
+};
+
+struct PreviewResult
+{
+	uint32_t rateShift;
+	// Lowest SNR over all checked samples
+	double snr;
+	// Total `Decode` time divided by total `DecodePreview` time
+	double speedup;
+};
+
+// Accumulated `DecodePreview` measurements for one rate shift
+struct PreviewTotal
+{
+	uint32_t rateShift;
+	double minSnr;
+	double decodeTime;
+	double previewTime;
+	uint32_t numSampleCountMismatches;
+};
+
+static void PrintUsage(const char **argv)
+{
+	cout << "Usage:\n";
+	cout << "  compare: " << argv[0] << " <baseline.txt>\n";
+	cout << "  update:  " << argv[0] << " --update <baseline.txt>\n";
+}
+
+static string ResultKey(const Result& result)
+{
+	ostringstream key;
+	key << result.sampleName << "@" << result.targetBitRate << "/" << result.estimatorName;
+	return key.str();
+}
+
+static double EstimateError(const Result& result)
+{
+	return (static_cast<double>(result.estimatedSize) - static_cast<double>(result.lzmaSize)) / static_cast<double>(result.lzmaSize) * 100.0;
+}
+
+static double TargetError(const Result& result)
+{
+	return (static_cast<double>(result.lzmaSize) - static_cast<double>(result.targetSize)) / static_cast<double>(result.targetSize) * 100.0;
+}
+
+// Returns the mean absolute value of a per-result error for each estimator, over results with a target size if requested
+template<typename ErrorFunction>
+static map<string, double> MeanAbsoluteErrors(const vector<Result>& results, ErrorFunction error, bool targetSizeRequired = false)
+{
+	map<string, pair<double, uint32_t>> sums;
+	for (const auto& result : results)
+	{
+		if (targetSizeRequired && !result.targetSize)
+			continue;
+		auto& sum = sums[result.estimatorName];
+		sum.first += abs(error(result));
+		sum.second++;
+	}
+	map<string, double> ret;
+	for (const auto& kvp : sums)
+		ret[kvp.first] = kvp.second.first / static_cast<double>(kvp.second.second);
+	return ret;
+}
+
+static uint32_t LzmaCompressedBankSize(const vector<vector<uint8_t>>& encodedSamples)
+{
+	vector<uint8_t> bank;
+	for (const auto& encodedSample : encodedSamples)
+		bank.insert(bank.end(), encodedSample.begin(), encodedSample.end());
+	return Harness::LzmaCompressedSize(bank);
+}
+
+// Returns the maximum absolute difference between `DecodeFixed`'s output and the given `Decode` output
+//  converted to 16 bits, in LSBs
+static uint32_t FixedDecoderDeviation(const vector<uint8_t>& encodedSample, const float *decodedSample, uint32_t numDecodedSamples)
+{
+	uint32_t numFixedDecodedSamples;
+	const auto fixedDecodedSample = Pulsejet::DecodeFixed(encodedSample.data(), &numFixedDecodedSamples);
+	uint32_t ret = numFixedDecodedSamples == numDecodedSamples ? 0 : UINT32_MAX;
+	for (uint32_t i = 0; i < numFixedDecodedSamples && i < numDecodedSamples; i++)
+	{
+		const auto reference = min(max(lrint(static_cast<double>(decodedSample[i]) * 32768.0), -32768L), 32767L);
+		ret = max(ret, static_cast<uint32_t>(labs(reference - fixedDecodedSample[i])));
+	}
+	delete [] fixedDecodedSample;
+	return ret;
+}
+
+// Splits an encoded sample (in either layout) into each of its frames' bytes: window mode, bins and band energies
+//  Comparing these (and the header) compares every byte of the sample.
+static vector<vector<uint8_t>> SplitFrames(const vector<uint8_t>& encodedSample)
+{
+	using namespace Pulsejet::Internal;
+
+	const auto numFramesField = static_cast<uint16_t>(encodedSample[8] | (encodedSample[9] << 8));
+	const auto numFrames = static_cast<uint32_t>(numFramesField & MaxNumFrames) + 1;
+	const auto isInterleaved = (numFramesField & InterleavedLayoutFlag) != 0;
+	const size_t headerSize = 10;
+
+	// The header stores one less than the number of frames (see `Decode`); each frame has `NumTotalBins` bins, split
+	//  between its subframes, and band energies for each subframe
+	vector<vector<uint8_t>> ret(numFrames);
+	auto pos = headerSize;
+	auto windowModePos = headerSize;
+	auto binsPos = headerSize + numFrames;
+	auto bandEnergiesPos = headerSize + numFrames * (1 + NumTotalBins);
+	for (auto& frame : ret)
+	{
+		if (isInterleaved)
+		{
+			windowModePos = pos;
+			binsPos = pos + 1;
+			bandEnergiesPos = binsPos + NumTotalBins;
+		}
+		const auto numBandEnergies = NumSubframes(static_cast<WindowMode>(encodedSample[windowModePos])) * NumBands;
+		frame.push_back(encodedSample[windowModePos++]);
+		frame.insert(frame.end(), encodedSample.begin() + binsPos, encodedSample.begin() + binsPos + NumTotalBins);
+		frame.insert(frame.end(), encodedSample.begin() + bandEnergiesPos, encodedSample.begin() + bandEnergiesPos + numBandEnergies);
+		binsPos += NumTotalBins;
+		bandEnergiesPos += numBandEnergies;
+		pos = bandEnergiesPos;
+	}
+	return ret;
+}
+
+// Returns the SNR (dB) of an encoded sample's `Decode` output relative to the given samples
+static double DecodedSnr(const vector<uint8_t>& encodedSample, const vector<float>& samples)
+{
+	uint32_t numDecodedSamples;
+	const auto decodedSample = Pulsejet::Decode(encodedSample.data(), &numDecodedSamples);
+	const auto ret = Harness::MeasureQuality(samples.data(), decodedSample, static_cast<uint32_t>(samples.size())).snr;
+	delete [] decodedSample;
+	return ret;
+}
+
+// Edits a sample, and checks that re-encoding the edited region with exact convergence reproduces a full encode of
+//  the edited sample, and that re-encoding it with the default convergence threshold (in both layouts) only changes
+//  frames near the edit, leaving all other bytes untouched, at the quality of a full encode
+static bool CheckReEncode(const vector<float>& samples, double targetBitRate, const vector<uint8_t>& encodedSample, const Pulsejet::EncodeState& state, const string& resultKey, ReEncodeTotal& inOutReEncodeTotal)
+{
+	const auto numSamples = static_cast<uint32_t>(samples.size());
+	const auto editStart = numSamples / 4;
+	const auto editEnd = min(editStart + ReEncodeEditSize, numSamples);
+	auto editedSamples = samples;
+	for (auto i = editStart; i < editEnd; i++)
+		editedSamples[i] *= ReEncodeEditGain;
+
+	double totalBitsEstimate;
+	const auto fullEncodedSample = Pulsejet::Encode(editedSamples.data(), numSamples, SampleRate, targetBitRate, totalBitsEstimate);
+	const auto fullSnr = DecodedSnr(fullEncodedSample, editedSamples);
+
+	auto ok = true;
+	{
+		auto exactState = state;
+		Pulsejet::ReEncodeOptions options;
+		options.convergenceBits = 0.0;
+		options.maxConvergenceFrames = UINT32_MAX;
+		if (Pulsejet::ReEncode(encodedSample, exactState, editedSamples.data(), numSamples, editStart, editEnd, totalBitsEstimate, options) != fullEncodedSample)
+		{
+			cout << "re-encode mismatch: " << resultKey << ": exactly-converged re-encode doesn't match full encode\n";
+			ok = false;
+		}
+	}
+
+	// Frames whose MDCTs cover the edit (which is offset by a frame of head padding) change, as may window modes up to two
+	//  frames further in each direction (see `ReEncode`); frames past those are only re-encoded until rate control
+	//  converges, or `maxConvergenceFrames` is reached
+	const auto firstAllowedFrame = max((editStart + Pulsejet::Internal::FrameSize) / Pulsejet::Internal::FrameSize, 2u) - 2;
+	const auto lastAllowedFrame = (editEnd - 1 + Pulsejet::Internal::FrameSize) / Pulsejet::Internal::FrameSize + 2 + Pulsejet::ReEncodeOptions().maxConvergenceFrames;
+
+	for (auto layout : { Pulsejet::StreamLayout::Concatenated, Pulsejet::StreamLayout::Interleaved })
+	{
+		const auto layoutName = layout == Pulsejet::StreamLayout::Interleaved ? "interleaved" : "concatenated";
+		auto layoutEncodedSample = encodedSample;
+		auto layoutState = state;
+		if (layout != Pulsejet::StreamLayout::Concatenated)
+		{
+			Pulsejet::EncodeOptions options;
+			options.layout = layout;
+			options.state = &layoutState;
+			layoutEncodedSample = Pulsejet::Encode(samples.data(), numSamples, SampleRate, targetBitRate, totalBitsEstimate, options);
+		}
+		const auto reEncodedSample = Pulsejet::ReEncode(layoutEncodedSample, layoutState, editedSamples.data(), numSamples, editStart, editEnd, totalBitsEstimate);
+
+		// Everything but the changed frames must match byte for byte, including the header
+		const auto frames = SplitFrames(layoutEncodedSample);
+		const auto reEncodedFrames = SplitFrames(reEncodedSample);
+		if (!equal(layoutEncodedSample.begin(), layoutEncodedSample.begin() + 10, reEncodedSample.begin()) || frames.size() != reEncodedFrames.size())
+		{
+			cout << "re-encode mismatch: " << resultKey << ": " << layoutName << " re-encode changes the header\n";
+			ok = false;
+			continue;
+		}
+		uint32_t firstChangedFrame = UINT32_MAX, lastChangedFrame = 0;
+		for (uint32_t i = 0; i < frames.size(); i++)
+		{
+			if (frames[i] == reEncodedFrames[i])
+				continue;
+			firstChangedFrame = min(firstChangedFrame, i);
+			lastChangedFrame = i;
+		}
+		if (firstChangedFrame != UINT32_MAX)
+		{
+			inOutReEncodeTotal.maxChangedFrames = max(inOutReEncodeTotal.maxChangedFrames, lastChangedFrame - firstChangedFrame + 1);
+			if (firstChangedFrame < firstAllowedFrame || lastChangedFrame > lastAllowedFrame)
+			{
+				cout << "re-encode mismatch: " << resultKey << ": " << layoutName << " re-encode changes frames " << firstChangedFrame << "-" << lastChangedFrame << ", outside of " << firstAllowedFrame << "-" << lastAllowedFrame << "\n";
+				ok = false;
+			}
+		}
+
+		const auto snrDifference = fabs(DecodedSnr(reEncodedSample, editedSamples) - fullSnr);
+		inOutReEncodeTotal.maxSnrDifference = max(inOutReEncodeTotal.maxSnrDifference, snrDifference);
+		if (snrDifference > ReEncodeMaxSnrDifference)
+		{
+			cout << "re-encode mismatch: " << resultKey << ": " << layoutName << " re-encode snr differs from full encode by " << snrDifference << " dB\n";
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+// Returns the best time (in ms) of a few runs of a decode function
+template<typename DecodeFunction>
+static double BestDecodeTime(DecodeFunction decode)
+{
+	auto ret = 0.0;
+	for (uint32_t i = 0; i < PreviewNumTimingRuns; i++)
+	{
+		uint32_t numSamples;
+		const auto start = chrono::steady_clock::now();
+		const auto samples = decode(&numSamples);
+		const auto time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		delete [] samples;
+		ret = i ? min(ret, time) : time;
+	}
+	return ret;
+}
+
+// Decodes a sample with `DecodePreview` at each checked rate, comparing the result with its band-limited, decimated
+//  `Decode` output, and timing both decoders
+static void MeasurePreviews(const vector<uint8_t>& encodedSample, const float *decodedSample, uint32_t numDecodedSamples, vector<PreviewTotal>& inOutPreviewTotals)
+{
+	const auto decodeTime = BestDecodeTime([&](uint32_t *outNumSamples) { return Pulsejet::Decode(encodedSample.data(), outNumSamples); });
+	for (auto& previewTotal : inOutPreviewTotals)
+	{
+		uint32_t numPreviewSamples;
+		const auto previewSample = Pulsejet::DecodePreview(encodedSample.data(), previewTotal.rateShift, &numPreviewSamples);
+		if (numPreviewSamples == numDecodedSamples >> previewTotal.rateShift)
+		{
+			const auto reference = Harness::BandLimitAndDecimate(decodedSample, numDecodedSamples, previewTotal.rateShift);
+			previewTotal.minSnr = min(previewTotal.minSnr, Harness::SignalToNoiseRatio(reference.data(), previewSample, numPreviewSamples));
+		}
+		else
+		{
+			previewTotal.numSampleCountMismatches++;
+		}
+		delete [] previewSample;
+
+		previewTotal.decodeTime += decodeTime;
+		previewTotal.previewTime += BestDecodeTime([&](uint32_t *outNumSamples) { return Pulsejet::DecodePreview(encodedSample.data(), previewTotal.rateShift, outNumSamples); });
+	}
+}
+
+static vector<Result> Run(vector<BankTotal>& outBankTotals, vector<PreviewTotal>& outPreviewTotals, uint32_t& outMaxFixedDeviation, ReEncodeTotal& outReEncodeTotal)
+{
+	outMaxFixedDeviation = 0;
+	outReEncodeTotal = { 0, 0, 0.0 };
+	outPreviewTotals.clear();
+	for (auto rateShift : PreviewRateShifts)
+		outPreviewTotals.push_back({ rateShift, HUGE_VAL, 0.0, 0.0, 0 });
+
+	Pulsejet::Order0BitsEstimator order0BitsEstimator;
+	Pulsejet::ContextBitsEstimator contextBitsEstimator;
+	const pair<string, Pulsejet::BitsEstimator *> bitsEstimators[] =
+	{
+		{ "order0", &order0BitsEstimator },
+		{ "context", &contextBitsEstimator },
+	};
+
+	const auto corpus = Harness::GenerateCorpus();
+
+	vector<Result> ret;
+	for (const auto& corpusSample : corpus)
+	{
+		const auto numSamples = static_cast<uint32_t>(corpusSample.samples.size());
+		for (auto targetBitRate : TargetBitRates)
+		for (const auto& bitsEstimator : bitsEstimators)
+		{
+			Result result;
+			result.sampleName = corpusSample.name;
+			result.targetBitRate = targetBitRate;
+			result.estimatorName = bitsEstimator.first;
+
+			Pulsejet::EncodeState state;
+			Pulsejet::EncodeOptions options;
+			options.bitsEstimator = bitsEstimator.second;
+			options.state = &state;
+			double totalBitsEstimate;
+			const auto encodedSample = Pulsejet::Encode(corpusSample.samples.data(), numSamples, SampleRate, targetBitRate, totalBitsEstimate, options);
+			if (bitsEstimator.second == &order0BitsEstimator && !CheckReEncode(corpusSample.samples, targetBitRate, encodedSample, state, ResultKey(result), outReEncodeTotal))
+				outReEncodeTotal.numFailures++;
+			result.rawSize = static_cast<uint32_t>(encodedSample.size());
+			result.zlibSize = Harness::ZlibCompressedSize(encodedSample);
+			result.lzmaSize = Harness::LzmaCompressedSize(encodedSample);
+			result.estimatedSize = static_cast<uint32_t>(ceil(totalBitsEstimate / 8.0));
+			result.targetSize = static_cast<uint32_t>(ceil(static_cast<double>(numSamples) / SampleRate * targetBitRate * 1000.0 / 8.0));
+
+			uint32_t numDecodedSamples;
+			const auto decodedSample = Pulsejet::Decode(encodedSample.data(), &numDecodedSamples);
+			result.quality = Harness::MeasureQuality(corpusSample.samples.data(), decodedSample, numSamples);
+			outMaxFixedDeviation = max(outMaxFixedDeviation, FixedDecoderDeviation(encodedSample, decodedSample, numDecodedSamples));
+			if (bitsEstimator.second == &order0BitsEstimator)
+				MeasurePreviews(encodedSample, decodedSample, numDecodedSamples, outPreviewTotals);
+			delete [] decodedSample;
+
+			ret.push_back(result);
+		}
+	}
+
+	// Encode the whole corpus as a bank, with the bank's compressed size measured using lzma
+	double totalDuration = 0.0;
+	vector<Pulsejet::BankSample> bankSamples;
+	for (const auto& corpusSample : corpus)
+	{
+		bankSamples.push_back({ corpusSample.samples.data(), static_cast<uint32_t>(corpusSample.samples.size()), SampleRate });
+		totalDuration += static_cast<double>(corpusSample.samples.size()) / SampleRate;
+	}
+	Pulsejet::BankEncodeOptions bankOptions;
+	bankOptions.measureCompressedSize = LzmaCompressedBankSize;
+	for (auto bankBitRate : BankBitRates)
+	{
+		const auto byteBudget = static_cast<uint32_t>(bankBitRate * 1000.0 / 8.0 * totalDuration);
+		const auto bankResult = Pulsejet::EncodeBank(bankSamples, byteBudget, bankOptions);
+		outBankTotals.push_back({ bankBitRate, byteBudget, static_cast<uint32_t>(bankResult.compressedSize) });
+
+		for (size_t i = 0; i < corpus.size(); i++)
+		{
+			const auto& corpusSample = corpus[i];
+			const auto& encodedSample = bankResult.encodedSamples[i];
+			const auto numSamples = static_cast<uint32_t>(corpusSample.samples.size());
+
+			Result result;
+			result.sampleName = corpusSample.name;
+			result.targetBitRate = bankBitRate;
+			result.estimatorName = "bank";
+			result.rawSize = static_cast<uint32_t>(encodedSample.size());
+			result.zlibSize = Harness::ZlibCompressedSize(encodedSample);
+			result.lzmaSize = Harness::LzmaCompressedSize(encodedSample);
+			result.estimatedSize = static_cast<uint32_t>(ceil(bankResult.bitsEstimates[i] / 8.0));
+
+			uint32_t numDecodedSamples;
+			const auto decodedSample = Pulsejet::Decode(encodedSample.data(), &numDecodedSamples);
+			result.quality = Harness::MeasureQuality(corpusSample.samples.data(), decodedSample, numSamples);
+			outMaxFixedDeviation = max(outMaxFixedDeviation, FixedDecoderDeviation(encodedSample, decodedSample, numDecodedSamples));
+			delete [] decodedSample;
+
+			ret.push_back(result);
+		}
+	}
+
+	return ret;
+}
+
+static void PrintResults(const vector<Result>& results)
+{
+	cout << left << setw(24) << "sample@kbps/estimator" << right
+		<< setw(8) << "raw" << setw(8) << "zlib" << setw(8) << "lzma"
+		<< setw(10) << "estimate" << setw(10) << "est.err%" << setw(10) << "tgt.err%"
+		<< setw(9) << "snr" << setw(9) << "lsd" << setw(9) << "nmr" << "\n";
+	for (const auto& result : results)
+	{
+		cout << left << setw(24) << ResultKey(result) << right
+			<< setw(8) << result.rawSize << setw(8) << result.zlibSize << setw(8) << result.lzmaSize
+			<< setw(10) << result.estimatedSize << setw(10) << fixed << setprecision(1) << EstimateError(result)
+			<< setw(10);
+		if (result.targetSize)
+			cout << TargetError(result);
+		else
+			cout << "-";
+		cout
+			<< setw(9) << setprecision(2) << result.quality.snr
+			<< setw(9) << result.quality.logSpectralDistance
+			<< setw(9) << result.quality.noiseToMaskRatio << "\n";
+		cout.unsetf(ios::floatfield);
+	}
+
+	// Summarize how well each estimator is calibrated against the actual compressed sizes, and how close rate control
+	//  with it gets to the target
+	for (const auto& kvp : MeanAbsoluteErrors(results, EstimateError))
+		cout << "mean absolute estimate error vs. lzma (" << kvp.first << "): " << fixed << setprecision(1) << kvp.second << "%\n";
+	for (const auto& kvp : MeanAbsoluteErrors(results, TargetError, true))
+		cout << "mean absolute lzma size error vs. target (" << kvp.first << "): " << fixed << setprecision(1) << kvp.second << "%\n";
+	cout.unsetf(ios::floatfield);
+}
+
+static bool WriteBaseline(const char *fileName, const vector<Result>& results, const vector<PreviewResult>& previewResults)
+{
+	ofstream baselineFile(fileName);
+	if (!baselineFile)
+		return false;
+	baselineFile << "# sample targetBitRate estimator rawSize zlibSize lzmaSize estimatedSize snr logSpectralDistance noiseToMaskRatio\n";
+	baselineFile << setprecision(6);
+	for (const auto& result : results)
+	{
+		baselineFile << result.sampleName << " " << result.targetBitRate << " " << result.estimatorName << " "
+			<< result.rawSize << " " << result.zlibSize << " " << result.lzmaSize << " " << result.estimatedSize << " "
+			<< result.quality.snr << " " << result.quality.logSpectralDistance << " " << result.quality.noiseToMaskRatio << "\n";
+	}
+	baselineFile << "# preview rateShift snr speedup\n";
+	for (const auto& previewResult : previewResults)
+		baselineFile << "preview " << previewResult.rateShift << " " << previewResult.snr << " " << previewResult.speedup << "\n";
+	return static_cast<bool>(baselineFile);
+}
+
+static bool ReadBaseline(const char *fileName, vector<Result>& outResults, vector<PreviewResult>& outPreviewResults)
+{
+	ifstream baselineFile(fileName);
+	if (!baselineFile)
+		return false;
+	string line;
+	while (getline(baselineFile, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		istringstream fields(line);
+		if (!line.compare(0, 8, "preview "))
+		{
+			string tag;
+			PreviewResult previewResult;
+			fields >> tag >> previewResult.rateShift >> previewResult.snr >> previewResult.speedup;
+			if (!fields)
+				return false;
+			outPreviewResults.push_back(previewResult);
+			continue;
+		}
+		Result result;
+		fields >> result.sampleName >> result.targetBitRate >> result.estimatorName
+			>> result.rawSize >> result.zlibSize >> result.lzmaSize >> result.estimatedSize
+			>> result.quality.snr >> result.quality.logSpectralDistance >> result.quality.noiseToMaskRatio;
+		if (!fields)
+			return false;
+		outResults.push_back(result);
+	}
+	return true;
+}
+
+static bool CheckSize(const string& key, const char *name, uint32_t size, uint32_t baselineSize)
+{
+	const auto relativeChange = (static_cast<double>(size) - static_cast<double>(baselineSize)) / static_cast<double>(baselineSize);
+	if (relativeChange > SizeTolerance)
+	{
+		cout << "REGRESSION: " << key << " " << name << " size " << baselineSize << " -> " << size << "\n";
+		return false;
+	}
+	if (relativeChange < -SizeTolerance)
+		cout << "note: " << key << " " << name << " size " << baselineSize << " -> " << size << " (consider updating the baseline)\n";
+	return true;
+}
+
+static bool CheckQuality(const string& key, const char *name, double value, double baselineValue, bool higherIsBetter)
+{
+	const auto improvement = higherIsBetter ? value - baselineValue : baselineValue - value;
+	if (improvement < -QualityTolerance)
+	{
+		cout << "REGRESSION: " << key << " " << name << " " << baselineValue << " -> " << value << "\n";
+		return false;
+	}
+	if (improvement > QualityTolerance)
+		cout << "note: " << key << " " << name << " " << baselineValue << " -> " << value << " (consider updating the baseline)\n";
+	return true;
+}
+
+static bool Compare(const vector<Result>& results, const vector<Result>& baselineResults)
+{
+	auto ok = true;
+	for (const auto& result : results)
+	{
+		const auto key = ResultKey(result);
+		const Result *baseline = nullptr;
+		for (const auto& baselineResult : baselineResults)
+		{
+			if (ResultKey(baselineResult) == key)
+				baseline = &baselineResult;
+		}
+		if (!baseline)
+		{
+			cout << "MISSING: " << key << " has no baseline\n";
+			ok = false;
+			continue;
+		}
+
+		// Size checks are combined with && last so that every deviation gets reported
+		ok = CheckSize(key, "raw", result.rawSize, baseline->rawSize) && ok;
+		ok = CheckSize(key, "zlib", result.zlibSize, baseline->zlibSize) && ok;
+		ok = CheckSize(key, "lzma", result.lzmaSize, baseline->lzmaSize) && ok;
+		ok = CheckSize(key, "estimated", result.estimatedSize, baseline->estimatedSize) && ok;
+		ok = CheckQuality(key, "snr", result.quality.snr, baseline->quality.snr, true) && ok;
+		ok = CheckQuality(key, "lsd", result.quality.logSpectralDistance, baseline->quality.logSpectralDistance, false) && ok;
+		ok = CheckQuality(key, "nmr", result.quality.noiseToMaskRatio, baseline->quality.noiseToMaskRatio, false) && ok;
+	}
+	return ok;
+}
+
+static bool ComparePreviews(const vector<PreviewResult>& previewResults, const vector<PreviewResult>& baselinePreviewResults)
+{
+	auto ok = true;
+	for (const auto& previewResult : previewResults)
+	{
+		const auto key = "preview@" + to_string(static_cast<uint32_t>(SampleRate) >> previewResult.rateShift) + "hz";
+		const PreviewResult *baseline = nullptr;
+		for (const auto& baselinePreviewResult : baselinePreviewResults)
+		{
+			if (baselinePreviewResult.rateShift == previewResult.rateShift)
+				baseline = &baselinePreviewResult;
+		}
+		if (!baseline)
+		{
+			cout << "note: " << key << " not in baseline\n";
+			continue;
+		}
+		ok = CheckQuality(key, "snr", previewResult.snr, baseline->snr, true) && ok;
+		if (previewResult.speedup < baseline->speedup * (1.0 - PreviewSpeedupTolerance))
+		{
+			cout << "REGRESSION: " << key << " speedup " << baseline->speedup << "x -> " << previewResult.speedup << "x\n";
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, const char **argv)
+{
+	const auto update = argc == 3 && !strcmp(argv[1], "--update");
+	if (argc != 2 && !update)
+	{
+		PrintUsage(argv);
+		return 1;
+	}
+	const auto baselineFileName = argv[argc - 1];
+
+	vector<BankTotal> bankTotals;
+	vector<PreviewTotal> previewTotals;
+	uint32_t maxFixedDeviation;
+	ReEncodeTotal reEncodeTotal;
+	const auto results = Run(bankTotals, previewTotals, maxFixedDeviation, reEncodeTotal);
+	PrintResults(results);
+
+	// Previews must decode the expected number of samples, and stay close to the band-limited full decode
+	vector<PreviewResult> previewResults;
+	auto previewsOk = true;
+	for (const auto& previewTotal : previewTotals)
+	{
+		const PreviewResult previewResult = { previewTotal.rateShift, previewTotal.minSnr, previewTotal.decodeTime / previewTotal.previewTime };
+		previewResults.push_back(previewResult);
+		const auto previewSampleRate = static_cast<uint32_t>(SampleRate) >> previewResult.rateShift;
+		cout << "preview @" << previewSampleRate << "hz: min snr " << fixed << setprecision(2) << previewResult.snr << " dB vs. decimated Decode, " << previewResult.speedup << "x faster\n";
+		cout.unsetf(ios::floatfield);
+		if (previewTotal.numSampleCountMismatches)
+		{
+			cout << "REGRESSION: preview @" << previewSampleRate << "hz decodes the wrong number of samples for " << previewTotal.numSampleCountMismatches << " sample(s)\n";
+			previewsOk = false;
+		}
+		if (previewResult.snr < PreviewMinSnr)
+		{
+			cout << "REGRESSION: preview @" << previewSampleRate << "hz snr is below " << PreviewMinSnr << " dB\n";
+			previewsOk = false;
+		}
+	}
+
+	// Exactly-converged re-encodes must always match full encodes, and converged re-encodes must stay local to the edit
+	cout << "re-encode: " << reEncodeTotal.numFailures << " mismatch(es), at most " << reEncodeTotal.maxChangedFrames << " changed frame(s), max snr difference " << fixed << setprecision(2) << reEncodeTotal.maxSnrDifference << " dB vs. full encode\n";
+	cout.unsetf(ios::floatfield);
+	const auto reEncodeOk = !reEncodeTotal.numFailures;
+	if (!reEncodeOk)
+		cout << "REGRESSION: re-encoding doesn't match full encodes or isn't local to the edit\n";
+
+	// The fixed-point decoder must always stay within its error bound
+	cout << "fixed decoder: max deviation " << maxFixedDeviation << " LSB(s)\n";
+	const auto fixedDeviationOk = maxFixedDeviation <= FixedDecoderMaxDeviation;
+	if (!fixedDeviationOk)
+		cout << "REGRESSION: fixed decoder deviation exceeds " << FixedDecoderMaxDeviation << " LSB(s)\n";
+
+	// Rate control with the context estimator must land closer to the target than with the order 0 estimator
+	auto targetErrors = MeanAbsoluteErrors(results, TargetError, true);
+	const auto contextEstimatorOk = targetErrors["context"] <= targetErrors["order0"];
+	if (!contextEstimatorOk)
+		cout << "REGRESSION: rate control with the context estimator doesn't land closer to the target than with order0\n";
+
+	// Banks must always meet their budgets
+	auto bankBudgetsMet = true;
+	for (const auto& bankTotal : bankTotals)
+	{
+		cout << "bank @" << setprecision(6) << bankTotal.bitRate << "kbps: " << bankTotal.lzmaSize << " of " << bankTotal.byteBudget << " byte(s) (lzma)\n";
+		if (bankTotal.lzmaSize > bankTotal.byteBudget)
+		{
+			cout << "REGRESSION: bank @" << bankTotal.bitRate << "kbps exceeds its budget\n";
+			bankBudgetsMet = false;
+		}
+	}
+
+	// Checks that don't depend on the baseline must pass before the baseline is updated, so that a regressed run can't
+	//  overwrite it
+	const auto checksOk = bankBudgetsMet && contextEstimatorOk && fixedDeviationOk && previewsOk && reEncodeOk;
+
+	if (update)
+	{
+		if (!checksOk)
+		{
+			cout << "ERROR: Not updating baseline, as other checks failed\n";
+			return 1;
+		}
+		if (!WriteBaseline(baselineFileName, results, previewResults))
+		{
+			cout << "ERROR: Couldn't write baseline " << baselineFileName << "\n";
+			return 1;
+		}
+		cout << "baseline updated: " << baselineFileName << "\n";
+		return 0;
+	}
+
+	vector<Result> baselineResults;
+	vector<PreviewResult> baselinePreviewResults;
+	if (!ReadBaseline(baselineFileName, baselineResults, baselinePreviewResults))
+	{
+		cout << "ERROR: Couldn't read baseline " << baselineFileName << "\n";
+		return 1;
+	}
+	const auto resultsOk = Compare(results, baselineResults);
+	const auto previewResultsOk = ComparePreviews(previewResults, baselinePreviewResults);
+	if (!resultsOk || !previewResultsOk || !checksOk)
+	{
+		cout << "rate/quality check FAILED\n";
+		return 1;
+	}
+	cout << "rate/quality check passed\n";
+	return 0;
+}
@@ -0,0 +1,185 @@
+#include "ReferenceDecoder.hpp"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace Harness
+{
+	// Codec constants are duplicated here on purpose, so that the reference stays put if the library changes
+	static const uint32_t FrameSize = 1024;
+	static const uint32_t NumShortWindowsPerFrame = 8;
+	static const uint32_t LongWindowSize = FrameSize * 2;
+	static const uint32_t ShortWindowSize = LongWindowSize / NumShortWindowsPerFrame;
+
+	static const uint32_t NumBands = 20;
+	static const uint32_t NumTotalBins = 856;
+
+	static const uint16_t NumFramesMask = 0x7fff;
+	static const uint16_t InterleavedLayoutFlag = 0x8000;
+
+	static const uint8_t WindowModeShort = 1;
+	static const uint8_t WindowModeStart = 2;
+	static const uint8_t WindowModeStop = 3;
+
+	static const uint8_t BandToNumBins[NumBands] =
+	{
+		8, 8, 8, 8, 8, 8, 8, 8, 16, 16, 24, 32, 32, 40, 48, 64, 80, 120, 144, 176,
+	};
+
+	static float VorbisWindow(const float nPlusHalf, const uint32_t size)
+	{
+		const auto sineWindow = sinf(static_cast<float>(M_PI) / static_cast<float>(size) * nPlusHalf);
+		return sinf(static_cast<float>(M_PI_2) * sineWindow * sineWindow);
+	}
+
+	static float MdctWindow(const float nPlusHalf, const uint32_t size, const uint8_t mode)
+	{
+		if (mode == WindowModeStart)
+		{
+			const auto shortWindowOffset = LongWindowSize * 3 / 4 - ShortWindowSize / 4;
+			if (nPlusHalf >= static_cast<float>(shortWindowOffset + ShortWindowSize / 2))
+				return 0.0f;
+			else if (nPlusHalf >= static_cast<float>(shortWindowOffset))
+				return 1.0f - VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
+			else if (nPlusHalf >= static_cast<float>(LongWindowSize / 2))
+				return 1.0f;
+		}
+		else if (mode == WindowModeStop)
+		{
+			const auto shortWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
+			if (nPlusHalf < static_cast<float>(shortWindowOffset))
+				return 0.0f;
+			else if (nPlusHalf < static_cast<float>(shortWindowOffset + ShortWindowSize / 2))
+				return VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
+			else if (nPlusHalf < static_cast<float>(LongWindowSize / 2))
+				return 1.0f;
+		}
+		return VorbisWindow(nPlusHalf, size);
+	}
+
+	float *ReferenceDecode(const uint8_t *inputStream, uint32_t *outNumSamples)
+	{
+		// Skip tag and codec version
+		inputStream += 8;
+
+		// Read frame count and layout flag
+		uint16_t numFramesField;
+		memcpy(&numFramesField, inputStream, sizeof(numFramesField));
+		inputStream += sizeof(uint16_t);
+		const auto isInterleaved = (numFramesField & InterleavedLayoutFlag) != 0;
+		const auto numOutputFrames = static_cast<uint32_t>(numFramesField & NumFramesMask);
+		const auto numSamples = numOutputFrames * FrameSize;
+		*outNumSamples = numSamples;
+
+		// One more frame is decoded than output
+		const auto numFrames = numOutputFrames + 1;
+
+		// Set up stream cursors (for the interleaved layout, these are set up per frame below)
+		auto windowModeStream = inputStream;
+		auto binQStream = reinterpret_cast<const int8_t *>(inputStream + numFrames);
+		auto bandEnergyStream = inputStream + numFrames * (1 + NumTotalBins);
+
+		const auto paddedSamples = new float[numSamples + FrameSize * 2]();
+
+		uint32_t lcgState = 0;
+		uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+
+		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		{
+			if (isInterleaved)
+			{
+				windowModeStream = inputStream;
+				binQStream = reinterpret_cast<const int8_t *>(inputStream + 1);
+				bandEnergyStream = inputStream + 1 + NumTotalBins;
+			}
+
+			const auto windowMode = *windowModeStream++;
+
+			uint32_t numSubframes = 1;
+			uint32_t subframeWindowOffset = 0;
+			uint32_t subframeWindowSize = LongWindowSize;
+			if (windowMode == WindowModeShort)
+			{
+				numSubframes = NumShortWindowsPerFrame;
+				subframeWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
+				subframeWindowSize = ShortWindowSize;
+			}
+
+			for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
+			{
+				float windowBins[FrameSize] = {};
+				auto bandBins = windowBins;
+				for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+				{
+					const auto numBins = BandToNumBins[bandIndex] / numSubframes;
+
+					uint32_t numNonzeroBins = 0;
+					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+					{
+						const auto binQ = *binQStream++;
+						if (binQ)
+							numNonzeroBins++;
+						bandBins[binIndex] = static_cast<float>(binQ);
+					}
+
+					// Noise fill
+					const auto binFill = static_cast<float>(numNonzeroBins) / static_cast<float>(numBins);
+					const auto noiseFillThreshold = 0.1f;
+					if (binFill < noiseFillThreshold)
+					{
+						const auto binSparsity = (noiseFillThreshold - binFill) / noiseFillThreshold;
+						const auto noiseFillGain = binSparsity * binSparsity;
+						for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+						{
+							const auto noiseSample = static_cast<float>(static_cast<int8_t>(lcgState >> 16)) / 127.0f;
+							bandBins[binIndex] += noiseSample * noiseFillGain;
+							lcgState = lcgState * 1664525 + 1013904223;
+						}
+					}
+
+					// Band energy
+					const uint8_t quantizedBandEnergy = quantizedBandEnergyPredictions[bandIndex] + *bandEnergyStream++;
+					quantizedBandEnergyPredictions[bandIndex] = quantizedBandEnergy;
+					const auto bandEnergyExponent = static_cast<float>(quantizedBandEnergy) / 64.0f * 40.0f - 20.0f;
+
+					float bandBinEnergy = 1e-27f;
+					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+						bandBinEnergy += bandBins[binIndex] * bandBins[binIndex];
+					const auto bandEnergy = exp2f(bandEnergyExponent) * static_cast<float>(numBins);
+					const auto binScale = bandEnergy / sqrtf(bandBinEnergy);
+					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+						bandBins[binIndex] *= binScale;
+
+					bandBins += numBins;
+				}
+
+				// IMDCT, windowing, and overlap-add
+				const auto numSubframeBins = subframeWindowSize / 2;
+				const auto frameOffset = frameIndex * FrameSize;
+				const auto windowOffset = subframeWindowOffset + subframeIndex * subframeWindowSize / 2;
+				for (uint32_t n = 0; n < subframeWindowSize; n++)
+				{
+					const auto nPlusHalf = static_cast<float>(n) + 0.5f;
+
+					auto sample = 0.0f;
+					for (uint32_t k = 0; k < numSubframeBins; k++)
+						sample += (2.0f / static_cast<float>(numSubframeBins)) * windowBins[k] * cosf(static_cast<float>(M_PI) / static_cast<float>(numSubframeBins) * (nPlusHalf + static_cast<float>(numSubframeBins / 2)) * (static_cast<float>(k) + 0.5f));
+
+					paddedSamples[frameOffset + windowOffset + n] += sample * MdctWindow(nPlusHalf, subframeWindowSize, windowMode);
+				}
+			}
+
+			if (isInterleaved)
+				inputStream = bandEnergyStream;
+		}
+
+		const auto samples = new float[numSamples];
+		memcpy(samples, paddedSamples + FrameSize, numSamples * sizeof(float));
+		delete [] paddedSamples;
+
+		return samples;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Harness
+{
+	// Frozen reference implementation of the pulsejet decoder, used by the conformance tool to check other
+	//  decoder implementations against. This is a self-contained copy of `Pulsejet::Decode` (as of codec version
+	//  1.0, reading both stream layouts) using libm directly, and is deliberately not optimized in any way.
+	//  It must not be changed along with the library's decoder(s), unless the codec itself changes.
+	//  Like `Pulsejet::Decode`, the returned buffer is allocated by `new []` and should be freed using `delete []`.
+	float *ReferenceDecode(const uint8_t *inputStream, uint32_t *outNumSamples);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Common.hpp"
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace Pulsejet::Internal
+{
+	using namespace Shims;
+
+	using namespace std;
+
+	// Batch shim dispatch
+	//  Users may optionally define batch overloads of the math shims in the `Pulsejet::Shims`
+	//  namespace, eg. `void CosF(const float *x, float *out, uint32_t n)`, which should write
+	//  `CosF(x[i])` to `out[i]` for each `i` in [0, n). `x` and `out` may point to the same
+	//  buffer. If such an overload is visible when the pulsejet header(s) are included, it's
+	//  used for bulk evaluation; otherwise, we fall back to calling the scalar shim once per
+	//  element. The overloads are detected via SFINAE on the (dependent) batch call expression
+	//  below, so nothing needs to be configured explicitly. Code paths that are only worthwhile
+	//  with batch shims (eg. restructured decoder loops) check the `Has*Batch` flags, so that
+	//  builds without batch shims keep the smaller scalar code.
+
+	template<typename T, typename = void>
+	struct HasCosFBatchImpl : false_type {};
+
+	template<typename T>
+	struct HasCosFBatchImpl<T, void_t<decltype(CosF(declval<const T *>(), declval<T *>(), declval<uint32_t>()))>> : true_type {};
+
+	inline constexpr bool HasCosFBatch = HasCosFBatchImpl<float>::value;
+
+	template<typename T>
+	void CosFBatch(const T *x, T *out, uint32_t n)
+	{
+		if constexpr (HasCosFBatchImpl<T>::value)
+		{
+			CosF(x, out, n);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < n; i++)
+				out[i] = CosF(x[i]);
+		}
+	}
+
+	template<typename T, typename = void>
+	struct HasExp2fBatchImpl : false_type {};
+
+	template<typename T>
+	struct HasExp2fBatchImpl<T, void_t<decltype(Exp2f(declval<const T *>(), declval<T *>(), declval<uint32_t>()))>> : true_type {};
+
+	inline constexpr bool HasExp2fBatch = HasExp2fBatchImpl<float>::value;
+
+	template<typename T>
+	void Exp2fBatch(const T *x, T *out, uint32_t n)
+	{
+		if constexpr (HasExp2fBatchImpl<T>::value)
+		{
+			Exp2f(x, out, n);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < n; i++)
+				out[i] = Exp2f(x[i]);
+		}
+	}
+
+	template<typename T, typename = void>
+	struct HasSinFBatchImpl : false_type {};
+
+	template<typename T>
+	struct HasSinFBatchImpl<T, void_t<decltype(SinF(declval<const T *>(), declval<T *>(), declval<uint32_t>()))>> : true_type {};
+
+	inline constexpr bool HasSinFBatch = HasSinFBatchImpl<float>::value;
+
+	template<typename T>
+	void SinFBatch(const T *x, T *out, uint32_t n)
+	{
+		if constexpr (HasSinFBatchImpl<T>::value)
+		{
+			SinF(x, out, n);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < n; i++)
+				out[i] = SinF(x[i]);
+		}
+	}
+
+	template<typename T, typename = void>
+	struct HasSqrtFBatchImpl : false_type {};
+
+	template<typename T>
+	struct HasSqrtFBatchImpl<T, void_t<decltype(SqrtF(declval<const T *>(), declval<T *>(), declval<uint32_t>()))>> : true_type {};
+
+	inline constexpr bool HasSqrtFBatch = HasSqrtFBatchImpl<float>::value;
+
+	template<typename T>
+	void SqrtFBatch(const T *x, T *out, uint32_t n)
+	{
+		if constexpr (HasSqrtFBatchImpl<T>::value)
+		{
+			SqrtF(x, out, n);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < n; i++)
+				out[i] = SqrtF(x[i]);
+		}
+	}
+}
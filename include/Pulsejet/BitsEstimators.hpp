@@ -0,0 +1,198 @@
+#pragma once
+
+#include "EncodeHelpers.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Pulsejet
+{
+	using namespace Internal;
+
+	using namespace std;
+
+	/**
+	 * Interface for estimating the number of bits an encoded sample will use
+	 * after compression, which the encoder uses for rate control.
+	 *
+	 * For each subframe, the encoder calls `EstimateSubframe` once per
+	 * candidate set of quantized symbols, picks the candidate whose estimate
+	 * is closest to its (rate controlled) target, and then calls
+	 * `CommitSubframe` with the chosen candidate. `CommitSubframe` returns the
+	 * chosen candidate's bits estimate as reported in the encoder's total
+	 * bits estimate, which may differ from the candidate estimate used for
+	 * rate control. Estimators may keep statistics across committed
+	 * subframes (for example, to model the correlations a packer will find
+	 * in the final stream), but `EstimateSubframe` must not affect later
+	 * estimates. `Reset` is called before each encoded sample.
+	 *
+	 * The symbols passed to these functions are the subframe's contributions
+	 * to the band energy stream and the quantized band bin stream, in stream
+	 * order.
+	 */
+	class BitsEstimator
+	{
+	public:
+		virtual ~BitsEstimator() = default;
+
+		virtual void Reset() = 0;
+		virtual double EstimateSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) = 0;
+		virtual double CommitSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) = 0;
+	};
+
+	/**
+	 * The encoder's default bits estimator.
+	 *
+	 * Models the order 0 entropy of each subframe's symbols in isolation, and
+	 * scales the result by a fixed factor, as squishy (and likely other
+	 * compressors) tend to find additional correlations not captured by this
+	 * simple model. Stateless, and therefore cheap, but consistently off for
+	 * material with a lot of inter-subframe correlation.
+	 */
+	class Order0BitsEstimator : public BitsEstimator
+	{
+	public:
+		void Reset() override
+		{
+		}
+
+		double EstimateSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) override
+		{
+			const double estimateAdjustment = 0.83;
+			return Order0SubframeBitsEstimate(bandEnergyStream, binQStream) * estimateAdjustment;
+		}
+
+		double CommitSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) override
+		{
+			return EstimateSubframe(bandEnergyStream, binQStream);
+		}
+	};
+
+	/**
+	 * A bits estimator based on adaptive context modeling.
+	 *
+	 * Each of the band energy and quantized band bin streams is modeled with
+	 * an adaptive context model (see `ContextModel`) whose statistics persist
+	 * across subframes, just like those of a context-mixing packer running
+	 * over the concatenated streams. Besides the preceding symbols in each
+	 * stream, the models use the symbol at the corresponding position in the
+	 * previous subframe as context. This captures inter-subframe and
+	 * inter-band correlations that `Order0BitsEstimator` misses.
+	 *
+	 * Committed subframes are costed with the models, and the models' bit
+	 * counts are tracked relative to the order 0 entropy of the same
+	 * subframes, separately for each stream. Candidates are then costed with
+	 * their order 0 entropy scaled by these running ratios, so rate control
+	 * spends more bits on material the models find cheap (and fewer on
+	 * material they find expensive), while candidates are still ranked the
+	 * same way within a subframe. Costing candidates with the models
+	 * directly instead makes symbols the models have already seen (mostly
+	 * zeros) cheap and everything else expensive, so rate control keeps
+	 * choosing coarser candidates, which teaches the models even more zeros
+	 * and starves later subframes.
+	 *
+	 * On the rate/quality harness corpus, this lands closer to the target
+	 * size than `Order0BitsEstimator` on average, mostly by spending fewer
+	 * bits where the order 0 estimate overshoots; quality drops accordingly
+	 * on those samples.
+	 */
+	class ContextBitsEstimator : public BitsEstimator
+	{
+	public:
+		/**
+		 * @param estimateAdjustment Factor applied to modeled bit counts,
+		 *        which can be used to calibrate this estimator against a
+		 *        specific packer. The default is calibrated against LZMA on
+		 *        the rate/quality harness corpus.
+		 */
+		explicit ContextBitsEstimator(double estimateAdjustment = DefaultEstimateAdjustment)
+			: estimateAdjustment(estimateAdjustment)
+		{
+		}
+
+		void Reset() override
+		{
+			bandEnergyModel.Reset();
+			binQModel.Reset();
+			prevBandEnergyStream.clear();
+			prevBinQStream.clear();
+			bandEnergyRatio = RunningRatio();
+			binQRatio = RunningRatio();
+		}
+
+		double EstimateSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) override
+		{
+			return
+				Order0StreamBitsEstimate(bandEnergyStream) * bandEnergyRatio.Ratio() +
+				Order0StreamBitsEstimate(binQStream) * binQRatio.Ratio();
+		}
+
+		double CommitSubframe(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream) override
+		{
+			// Band energies are always coded for all bands, so they correspond one to one with the previous subframe's
+			double bandEnergyBits = 0.0;
+			for (size_t i = 0; i < bandEnergyStream.size(); i++)
+			{
+				const auto sideContext = i < prevBandEnergyStream.size() ? prevBandEnergyStream[i] : 0;
+				bandEnergyBits += bandEnergyModel.Encode(bandEnergyStream[i], sideContext);
+			}
+
+			// Long and short subframes have the same band layout with bin counts differing by a constant factor,
+			//  so bins are mapped to previous subframe bins proportionally
+			double binQBits = 0.0;
+			for (size_t i = 0; i < binQStream.size(); i++)
+			{
+				const auto prevIndex = i * prevBinQStream.size() / binQStream.size();
+				const auto sideContext = prevIndex < prevBinQStream.size() ? static_cast<uint8_t>(prevBinQStream[prevIndex]) : 0;
+				binQBits += binQModel.Encode(static_cast<uint8_t>(binQStream[i]), sideContext);
+			}
+
+			bandEnergyBits *= estimateAdjustment;
+			binQBits *= estimateAdjustment;
+			bandEnergyRatio.Add(bandEnergyBits, Order0StreamBitsEstimate(bandEnergyStream));
+			binQRatio.Add(binQBits, Order0StreamBitsEstimate(binQStream));
+
+			prevBandEnergyStream = bandEnergyStream;
+			prevBinQStream = binQStream;
+			return bandEnergyBits + binQBits;
+		}
+
+	private:
+		// Minimizes the mean absolute estimate error vs. LZMA over the rate/quality harness corpus
+		static constexpr double DefaultEstimateAdjustment = 1.03;
+
+		// Ratio of modeled bits to order 0 bits over all of a stream's committed subframes
+		//  Until enough subframes have been seen, it's pulled towards `Order0BitsEstimator`'s fixed adjustment. The
+		//  ratio deliberately isn't windowed; letting it follow the material makes it swing from subframe to
+		//  subframe, and allocating bits unevenly over time costs more quality than tracking the material gains.
+		class RunningRatio
+		{
+		public:
+			void Add(double modeledBits, double order0Bits)
+			{
+				this->modeledBits += modeledBits;
+				this->order0Bits += order0Bits;
+			}
+
+			double Ratio() const
+			{
+				return (modeledBits + PriorOrder0Bits * PriorRatio) / (order0Bits + PriorOrder0Bits);
+			}
+
+		private:
+			static constexpr double PriorOrder0Bits = 5000.0;
+			static constexpr double PriorRatio = 0.83;
+
+			double modeledBits = 0.0;
+			double order0Bits = 0.0;
+		};
+
+		double estimateAdjustment;
+		ContextModel bandEnergyModel;
+		ContextModel binQModel;
+		vector<uint8_t> prevBandEnergyStream;
+		vector<int8_t> prevBinQStream;
+		RunningRatio bandEnergyRatio;
+		RunningRatio binQRatio;
+	};
+}
@@ -4,14 +4,49 @@
 #include <cmath>
 #include <cstdint>
 
+namespace Pulsejet
+{
+	/**
+	 * Layout of the data following an encoded sample's header.
+	 */
+	enum class StreamLayout {
+		/**
+		 * All window modes, followed by all quantized band bins, followed
+		 * by all band energies. Grouping similar data together this way
+		 * results in the best ratios with general-purpose compressors.
+		 */
+		Concatenated = 0,
+		/**
+		 * Each frame's window mode, quantized band bins and band energies
+		 * are stored together, in that order, so that each frame is
+		 * decoded from one contiguous region of the stream. Useful for
+		 * streaming, memory-mapped or chunked playback, at the cost of
+		 * somewhat worse ratios with general-purpose compressors.
+		 */
+		Interleaved = 1,
+	};
+}
+
 namespace Pulsejet::Internal
 {
-	using namespace Shims;
+	inline constexpr const char *SampleTag = "PLSJ";
+
+	inline constexpr uint16_t CodecVersionMajor = 1;
+	inline constexpr uint16_t CodecVersionMinor = 0;
 
-	static const char *SampleTag = "PLSJ";
+	// The header's frame count field holds the frame count in its lower 15 bits, and flags the interleaved
+	//  stream layout with its top bit
+	inline constexpr uint32_t MaxNumFrames = 0x7fff;
+	inline constexpr uint16_t InterleavedLayoutFlag = 0x8000;
 
-	inline constexpr uint16_t CodecVersionMajor = 0;
-	inline constexpr uint16_t CodecVersionMinor = 1;
+	// Decoders read both stream layouts, unless `PULSEJET_NO_INTERLEAVED_LAYOUT` is defined before including the
+	//  pulsejet header(s), in which case they only read the concatenated layout (behavior is undefined for interleaved
+	//  samples). This saves a bit of code in size-constrained builds whose samples are all concatenated.
+#ifdef PULSEJET_NO_INTERLEAVED_LAYOUT
+	inline constexpr bool SupportsInterleavedLayout = false;
+#else
+	inline constexpr bool SupportsInterleavedLayout = true;
+#endif
 
 	inline constexpr uint32_t FrameSize = 1024;
 	inline constexpr uint32_t NumShortWindowsPerFrame = 8;
@@ -28,52 +63,13 @@ namespace Pulsejet::Internal
 		Stop = 3,
 	};
 
-	static const uint8_t BandToNumBins[NumBands] =
-	{
-		8, 8, 8, 8, 8, 8, 8, 8, 16, 16, 24, 32, 32, 40, 48, 64, 80, 120, 144, 176,
-	};
-
-	static float VorbisWindow(const float nPlusHalf, const uint32_t size)
+	inline uint32_t NumSubframes(const WindowMode windowMode)
 	{
-		const auto sineWindow = SinF(static_cast<float>(M_PI) / static_cast<float>(size) * nPlusHalf);
-		return SinF(static_cast<float>(M_PI_2) * sineWindow * sineWindow);
+		return windowMode == WindowMode::Short ? NumShortWindowsPerFrame : 1;
 	}
 
-	inline float MdctWindow(const uint32_t n, const uint32_t size, const WindowMode mode)
+	static constexpr uint8_t BandToNumBins[NumBands] =
 	{
-		const auto nPlusHalf = static_cast<float>(n) + 0.5f;
-		if (mode == WindowMode::Start)
-		{
-			const auto shortWindowOffset = LongWindowSize * 3 / 4 - ShortWindowSize / 4;
-			if (n >= shortWindowOffset + ShortWindowSize / 2)
-			{
-				return 0.0f;
-			}
-			else if (n >= shortWindowOffset)
-			{
-				return 1.0f - VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
-			}
-			else if (n >= LongWindowSize / 2)
-			{
-				return 1.0f;
-			}
-		}
-		else if (mode == WindowMode::Stop)
-		{
-			const auto shortWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
-			if (n < shortWindowOffset)
-			{
-				return 0.0f;
-			}
-			else if (n < shortWindowOffset + ShortWindowSize / 2)
-			{
-				return VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
-			}
-			else if (n < LongWindowSize / 2)
-			{
-				return 1.0f;
-			}
-		}
-		return VorbisWindow(nPlusHalf, size);
-	}
+		8, 8, 8, 8, 8, 8, 8, 8, 16, 16, 24, 32, 32, 40, 48, 64, 80, 120, 144, 176,
+	};
 }
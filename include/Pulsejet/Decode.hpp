@@ -1,169 +1,392 @@
 #pragma once
 
+#include "BatchShims.hpp"
 #include "Common.hpp"
+#include "MdctWindow.hpp"
 
 #include <cstdint>
 #include <cstring>
 
-namespace Pulsejet
+namespace Pulsejet::Internal
 {
-	using namespace Internal;
-	using namespace Shims;
+	// Frames are decoded with kernels specialized for long and short windows (see `DecodeSubframes`), unless
+	//  `PULSEJET_NO_SPECIALIZED_DECODE_KERNELS` is defined before including the pulsejet header(s), in which case a single
+	//  generic kernel handles all frames. This saves code in size-constrained builds.
+#ifdef PULSEJET_NO_SPECIALIZED_DECODE_KERNELS
+	inline constexpr bool UseSpecializedDecodeKernels = false;
+#else
+	inline constexpr bool UseSpecializedDecodeKernels = true;
+#endif
 
-	/**
-	 * Decodes an encoded pulsejet sample into a newly-allocated buffer.
-	 *
-	 * This function is optimized for size and designed to be compiled in a
-	 * size-constrained environment. In such environments, it's common not
-	 * to have access to all of the required math functions, and instead
-	 * implement them by hand. For this reason, this decoder does not
-	 * depend on any such functions directly, and instead expects that
-	 * `CosF`, `Exp2F`, `SinF`, and `SqrtF` functions are defined in the
-	 * `Pulsejet::Shims` namespace before including relevant pulsejet
-	 * header(s). pulsejet expects that these functions behave similarly
-	 * to the corresponding similarly-named cmath functions. This shim
-	 * mechanism can also be used to provide less accurate, speed-optimized
-	 * versions of these functions if desired.
-	 *
-	 * Additionally, this function will not perform any error checking or
-	 * handling. The included metadata API can be used for high-level error
-	 * checking before decoding takes place if required (albeit not in a
-	 * non-size-constrained environment).
-	 *
-	 * @param inputStream Encoded pulsejet byte stream.
-	 * @param[out] outNumSamples Number of decoded samples.
-	 * @return Decoded samples in the [-1, 1] range (normalized).
-	 *         This buffer is allocated by `new []` and should be freed
-	 *         using `delete []`.
-	 */
-	static float *Decode(const uint8_t *inputStream, uint32_t *outNumSamples)
+	// If `PULSEJET_IMDCT_COSINE_TABLES` is defined before including the pulsejet header(s), the specialized kernels look up
+	//  the IMDCT's cosines from tables shared by all decodes (see `ImdctCosines`), instead of evaluating them for every
+	//  subframe. This makes decoding many times faster, but the tables take up to ~10.7MB, which is held until the program
+	//  exits.
+#ifdef PULSEJET_IMDCT_COSINE_TABLES
+	inline constexpr bool UseImdctCosineTables = UseSpecializedDecodeKernels;
+#else
+	inline constexpr bool UseImdctCosineTables = false;
+#endif
+
+	// Band sizes and offsets within a subframe's bins
+	struct SubframeBandLayout
 	{
-		// Skip tag and codec version
-		inputStream += 8;
+		uint32_t numBins[NumBands];
+		uint32_t offsets[NumBands];
+	};
 
-		// Read frame count, determine number of samples, and allocate output sample buffer
-		auto numFrames = static_cast<uint32_t>(*(reinterpret_cast<const uint16_t *>(inputStream)));
-		inputStream += sizeof(uint16_t);
-		const auto numSamples = numFrames * FrameSize;
-		*outNumSamples = numSamples;
-		const auto samples = new float[numSamples];
+	// Band layout for each subframe configuration, as used by the specialized kernels
+	template<uint32_t NumSubframes>
+	inline constexpr SubframeBandLayout SubframeBands = []
+	{
+		SubframeBandLayout ret = {};
+		uint32_t offset = 0;
+		for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+		{
+			ret.numBins[bandIndex] = BandToNumBins[bandIndex] / NumSubframes;
+			ret.offsets[bandIndex] = offset;
+			offset += ret.numBins[bandIndex];
+		}
+		return ret;
+	}();
 
-		// We're going to decode one more frame than we output, so adjust the frame count
-		numFrames++;
+	// Number of (leading) bands of a subframe configuration that overlap the output bandwidth at 44100hz >> `PreviewShift`
+	template<uint32_t PreviewShift, uint32_t NumSubframes>
+	inline constexpr uint32_t NumDecodedBands = []
+	{
+		constexpr auto numOutputBins = FrameSize / NumSubframes >> PreviewShift;
+		uint32_t ret = 0;
+		while (ret < NumBands && SubframeBands<NumSubframes>.offsets[ret] < numOutputBins)
+			ret++;
+		return ret;
+	}();
 
-		// Set up and skip window mode stream
-		auto windowModeStream = inputStream;
-		inputStream += numFrames;
+	// Number of bins in a subframe band, from the band layout table if the subframe configuration is known at compile time
+	template<uint32_t NumSubframes>
+	inline uint32_t SubframeBandNumBins(const uint32_t bandIndex, const uint32_t numSubframes)
+	{
+		if constexpr (NumSubframes > 0)
+			return SubframeBands<NumSubframes>.numBins[bandIndex];
+		else
+			return BandToNumBins[bandIndex] / numSubframes;
+	}
 
-		// Set up and skip quantized band bin stream
-		auto quantizedBandBinStream = reinterpret_cast<const int8_t *>(inputStream);
-		inputStream += numFrames * NumTotalBins;
+	// Number of output samples whose IMDCT sums are accumulated side by side with IMDCT cosine tables
+	inline constexpr uint32_t ImdctBlockSize = 8;
 
-		// Allocate padded sample buffer, and fill with silence
-		const auto numPaddedSamples = numSamples + FrameSize * 2;
-		const auto paddedSamples = new float[numPaddedSamples]();
+	// IMDCT cosines for a specialized kernel's subframe configuration (see `UseImdctCosineTables`)
+	//  These only depend on the configuration, so they're evaluated when the configuration is first used, and shared by all
+	//  decodes (including concurrent ones) until the program exits. Each table holds an output window's worth of cosines
+	//  for each output bin: 8MB for long and 128KB for short windows at the full output rate, 2MB and 32KB at 22050hz,
+	//  and 512KB and 8KB at 11025hz, so ~8.1MB for `Decode` alone, and ~10.7MB when previews at both rates are decoded as
+	//  well. The long window tables don't fit in caches, but streaming them is still much faster than evaluating their
+	//  cosines. They're laid out in blocks of output samples with each block's cosines interleaved, so that the block's
+	//  sums can be accumulated side by side.
+	template<uint32_t PreviewShift, uint32_t NumSubframes>
+	const float *ImdctCosines()
+	{
+		static const auto table = []
+		{
+			constexpr auto subframeWindowSize = NumSubframes > 1 ? ShortWindowSize : LongWindowSize;
+			constexpr auto outputWindowSize = subframeWindowSize >> PreviewShift;
+			constexpr auto numOutputBins = subframeWindowSize / 2 >> PreviewShift;
+			static_assert(outputWindowSize % ImdctBlockSize == 0, "IMDCT block size must divide all output window sizes");
 
-		// Initialize LCG
-		uint32_t lcgState = 0;
+			constexpr auto numCosines = outputWindowSize * numOutputBins;
+			const auto ret = new float[numCosines];
+			auto cosines = ret;
+			for (uint32_t n = 0; n < outputWindowSize; n += ImdctBlockSize)
+			{
+				for (uint32_t k = 0; k < numOutputBins; k++)
+					for (uint32_t i = 0; i < ImdctBlockSize; i++)
+					{
+						const auto nPlusHalf = static_cast<float>(n + i) + 0.5f;
+						*cosines++ = static_cast<float>(M_PI) / static_cast<float>(numOutputBins) * (nPlusHalf + static_cast<float>(numOutputBins / 2)) * (static_cast<float>(k) + 0.5f);
+					}
+			}
+			CosFBatch(ret, ret, numCosines);
+			return ret;
+		}();
+		return table;
+	}
 
-		// Clear quantized band energy predictions
-		uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+	// Decodes a frame's subframe(s), and accumulates their windowed output into the frame's padded output samples
+	//  `NumSubframes` is the frame's number of subframes (1 for long windows, `NumShortWindowsPerFrame` for short windows),
+	//  which makes the subframe window size, all band sizes (see `SubframeBands`), the number of decoded bands, and all loop
+	//  trip counts compile-time constants, so that the compiler can fold, unroll and vectorize accordingly. If it's 0, the
+	//  subframe configuration is determined from the window mode at runtime instead, so that a single kernel handles all
+	//  frames (see `UseSpecializedDecodeKernels`).
+	//  `windowBins` is scratch space for at least `FrameSize` bins, which is provided by the caller so that the generic
+	//  kernel can be inlined into it.
+	template<uint32_t PreviewShift, uint32_t NumSubframes>
+	static void DecodeSubframes(const WindowMode windowMode, const uint8_t *& inputStream, const int8_t *& quantizedBandBinStream, uint8_t *quantizedBandEnergyPredictions, uint32_t& lcgState, float *windowBins, float *frameSamples)
+	{
+		// Determine subframe configuration, from the window mode if it isn't known at compile time
+		uint32_t numSubframes = 1;
+		uint32_t subframeWindowOffset = 0;
+		uint32_t subframeWindowSize = LongWindowSize;
+		if (NumSubframes ? NumSubframes > 1 : windowMode == WindowMode::Short)
+		{
+			numSubframes = NumShortWindowsPerFrame;
+			subframeWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
+			subframeWindowSize = ShortWindowSize;
+		}
 
-		// Decode frames
-		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
 		{
-			// Read window mode for this frame
-			const auto windowMode = static_cast<WindowMode>(*windowModeStream++);
+			// Determine how many of the subframe's bins and bands fall within the output bandwidth
+			const auto numSubframeBins = subframeWindowSize / 2;
+			const auto numOutputBins = numSubframeBins >> PreviewShift;
+			uint32_t numDecodedBands = NumBands;
+			if constexpr (PreviewShift > 0)
+				numDecodedBands = numSubframes > 1 ? NumDecodedBands<PreviewShift, NumShortWindowsPerFrame> : NumDecodedBands<PreviewShift, 1>;
 
-			// Determine subframe configuration from window mode
-			uint32_t numSubframes = 1;
-			uint32_t subframeWindowOffset = 0;
-			uint32_t subframeWindowSize = LongWindowSize;
-			if (windowMode == WindowMode::Short)
+			// Decode bands
+			//  With batch shims, band energies and band bin energy norms are evaluated for all bands at once after this loop
+			constexpr auto batchBandEnergies = HasExp2fBatch && HasSqrtFBatch;
+			memset(windowBins, 0, FrameSize / (NumSubframes ? NumSubframes : 1) * sizeof(float));
+			float bandEnergyExponents[NumBands];
+			float bandBinEnergies[NumBands];
+			auto bandBins = windowBins;
+			for (uint32_t bandIndex = 0; bandIndex < numDecodedBands; bandIndex++)
 			{
-				numSubframes = NumShortWindowsPerFrame;
-				subframeWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
-				subframeWindowSize = ShortWindowSize;
+				const auto numBins = SubframeBandNumBins<NumSubframes>(bandIndex, numSubframes);
+
+				// Decode band bins
+				uint32_t numNonzeroBins = 0;
+				for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+				{
+					const auto binQ = *quantizedBandBinStream++;
+					if (binQ)
+						numNonzeroBins++;
+					const auto bin = static_cast<float>(binQ);
+					bandBins[binIndex] = bin;
+				}
+
+				// If this band is significantly sparse, fill in (nearly) spectrally flat noise
+				const auto binFill = static_cast<float>(numNonzeroBins) / static_cast<float>(numBins);
+				const auto noiseFillThreshold = 0.1f;
+				if (binFill < noiseFillThreshold)
+				{
+					const auto binSparsity = (noiseFillThreshold - binFill) / noiseFillThreshold;
+					const auto noiseFillGain = binSparsity * binSparsity;
+					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+					{
+						const auto noiseSample = static_cast<float>(static_cast<int8_t>(lcgState >> 16)) / 127.0f;
+						bandBins[binIndex] += noiseSample * noiseFillGain;
+
+						// Transition LCG state using Numerical Recipes parameters
+						lcgState = lcgState * 1664525 + 1013904223;
+					}
+				}
+
+				// Decode band energy
+				const auto quantizedBandEnergyResidual = *inputStream++;
+				const uint8_t quantizedBandEnergy = quantizedBandEnergyPredictions[bandIndex] + quantizedBandEnergyResidual;
+				quantizedBandEnergyPredictions[bandIndex] = quantizedBandEnergy;
+				const auto bandEnergyExponent = static_cast<float>(quantizedBandEnergy) / 64.0f * 40.0f - 20.0f;
+
+				// Normalize band bins and scale by band energy
+				const float epsilon = 1e-27f;
+				auto bandBinEnergy = epsilon;
+				for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+				{
+					const auto bin = bandBins[binIndex];
+					bandBinEnergy += bin * bin;
+				}
+				if constexpr (batchBandEnergies)
+				{
+					bandEnergyExponents[bandIndex] = bandEnergyExponent;
+					bandBinEnergies[bandIndex] = bandBinEnergy;
+				}
+				else
+				{
+					const auto bandEnergy = Exp2f(bandEnergyExponent) * static_cast<float>(numBins);
+					bandBinEnergy = SqrtF(bandBinEnergy);
+					const auto binScale = bandEnergy / bandBinEnergy;
+					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+						bandBins[binIndex] *= binScale;
+				}
+
+				bandBins += numBins;
 			}
 
-			// Decode subframe(s)
-			for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
+			// Bands entirely above the output bandwidth are only skipped over, though their energies still feed predictions,
+			//  and their noise fill still advances the LCG, so that the noise in the decoded bands matches a full decode
+			if constexpr (PreviewShift > 0)
 			{
-				// Decode bands
-				float windowBins[FrameSize] = {};
-				auto bandBins = windowBins;
-				for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+				for (uint32_t bandIndex = numDecodedBands; bandIndex < NumBands; bandIndex++)
 				{
-					// Decode band bins
-					const auto numBins = BandToNumBins[bandIndex] / numSubframes;
+					const auto numBins = SubframeBandNumBins<NumSubframes>(bandIndex, numSubframes);
 					uint32_t numNonzeroBins = 0;
 					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
 					{
-						const auto binQ = *quantizedBandBinStream++;
-						if (binQ)
+						if (*quantizedBandBinStream++)
 							numNonzeroBins++;
-						const auto bin = static_cast<float>(binQ);
-						bandBins[binIndex] = bin;
 					}
-
-					// If this band is significantly sparse, fill in (nearly) spectrally flat noise
 					const auto binFill = static_cast<float>(numNonzeroBins) / static_cast<float>(numBins);
-					const auto noiseFillThreshold = 0.1f;
-					if (binFill < noiseFillThreshold)
+					if (binFill < 0.1f)
 					{
-						const auto binSparsity = (noiseFillThreshold - binFill) / noiseFillThreshold;
-						const auto noiseFillGain = binSparsity * binSparsity;
 						for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
-						{
-							const auto noiseSample = static_cast<float>(static_cast<int8_t>(lcgState >> 16)) / 127.0f;
-							bandBins[binIndex] += noiseSample * noiseFillGain;
-
-							// Transition LCG state using Numerical Recipes parameters
 							lcgState = lcgState * 1664525 + 1013904223;
-						}
 					}
+					quantizedBandEnergyPredictions[bandIndex] += *inputStream++;
+				}
+			}
 
-					// Decode band energy
-					const auto quantizedBandEnergyResidual = *inputStream++;
-					const uint8_t quantizedBandEnergy = quantizedBandEnergyPredictions[bandIndex] + quantizedBandEnergyResidual;
-					quantizedBandEnergyPredictions[bandIndex] = quantizedBandEnergy;
-					const auto bandEnergy = Exp2f(static_cast<float>(quantizedBandEnergy) / 64.0f * 40.0f - 20.0f) * static_cast<float>(numBins);
+			if constexpr (batchBandEnergies)
+			{
+				Exp2fBatch(bandEnergyExponents, bandEnergyExponents, numDecodedBands);
+				SqrtFBatch(bandBinEnergies, bandBinEnergies, numDecodedBands);
 
-					// Normalize band bins and scale by band energy
-					const float epsilon = 1e-27f;
-					auto bandBinEnergy = epsilon;
-					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
-					{
-						const auto bin = bandBins[binIndex];
-						bandBinEnergy += bin * bin;
-					}
-					bandBinEnergy = SqrtF(bandBinEnergy);
-					const auto binScale = bandEnergy / bandBinEnergy;
+				bandBins = windowBins;
+				for (uint32_t bandIndex = 0; bandIndex < numDecodedBands; bandIndex++)
+				{
+					const auto numBins = SubframeBandNumBins<NumSubframes>(bandIndex, numSubframes);
+					const auto bandEnergy = bandEnergyExponents[bandIndex] * static_cast<float>(numBins);
+					const auto binScale = bandEnergy / bandBinEnergies[bandIndex];
 					for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
 						bandBins[binIndex] *= binScale;
 
 					bandBins += numBins;
 				}
+			}
 
-				// Apply the IMDCT to the subframe bins, then apply the appropriate window to the resulting samples, and finally accumulate them into the padded output buffer
-				const auto frameOffset = frameIndex * FrameSize;
-				const auto windowOffset = subframeWindowOffset + subframeIndex * subframeWindowSize / 2;
-				for (uint32_t n = 0; n < subframeWindowSize; n++)
+			// Apply the IMDCT to the subframe bins, then apply the appropriate window to the resulting samples, and finally accumulate them into the padded output buffer
+			//  At reduced output rates, only the bins within the output bandwidth are used, and the IMDCT is evaluated at the
+			//  correspondingly reduced size, which (up to the normalization factor) samples the full-size IMDCT output
+			const auto windowOffset = (subframeWindowOffset + subframeIndex * subframeWindowSize / 2) >> PreviewShift;
+			const auto outputWindowSize = subframeWindowSize >> PreviewShift;
+			if constexpr (UseImdctCosineTables && NumSubframes > 0)
+			{
+				// The IMDCT's cosines are looked up from the shared table for this configuration (see `ImdctCosines`). Each sum
+				//  still sees exactly the same terms in the same order as when evaluating them, so the results don't change.
+				auto cosines = ImdctCosines<PreviewShift, NumSubframes>();
+				for (uint32_t n = 0; n < outputWindowSize; n += ImdctBlockSize)
+				{
+					float samples[ImdctBlockSize] = {};
+					for (uint32_t k = 0; k < numOutputBins; k++)
+					{
+						const auto bin = (2.0f / static_cast<float>(numSubframeBins)) * windowBins[k];
+						for (uint32_t i = 0; i < ImdctBlockSize; i++)
+							samples[i] += bin * cosines[i];
+						cosines += ImdctBlockSize;
+					}
+
+					for (uint32_t i = 0; i < ImdctBlockSize; i++)
+					{
+						const auto nPlusHalf = static_cast<float>(n + i) + 0.5f;
+						auto window = MdctWindow(nPlusHalf * static_cast<float>(1 << PreviewShift), subframeWindowSize, windowMode);
+						frameSamples[windowOffset + n + i] += samples[i] * window;
+					}
+				}
+			}
+			else
+			{
+				for (uint32_t n = 0; n < outputWindowSize; n++)
 				{
 					const auto nPlusHalf = static_cast<float>(n) + 0.5f;
 
 					auto sample = 0.0f;
-					for (uint32_t k = 0; k < subframeWindowSize / 2; k++)
-						sample += (2.0f / static_cast<float>(subframeWindowSize / 2)) * windowBins[k] * CosF(static_cast<float>(M_PI) / static_cast<float>(subframeWindowSize / 2) * (nPlusHalf + static_cast<float>(subframeWindowSize / 4)) * (static_cast<float>(k) + 0.5f));
+					if constexpr (HasCosFBatch)
+					{
+						float cosines[FrameSize];
+						for (uint32_t k = 0; k < numOutputBins; k++)
+							cosines[k] = static_cast<float>(M_PI) / static_cast<float>(numOutputBins) * (nPlusHalf + static_cast<float>(numOutputBins / 2)) * (static_cast<float>(k) + 0.5f);
+						CosFBatch(cosines, cosines, numOutputBins);
+
+						for (uint32_t k = 0; k < numOutputBins; k++)
+							sample += (2.0f / static_cast<float>(numSubframeBins)) * windowBins[k] * cosines[k];
+					}
+					else
+					{
+						for (uint32_t k = 0; k < numOutputBins; k++)
+							sample += (2.0f / static_cast<float>(numSubframeBins)) * windowBins[k] * CosF(static_cast<float>(M_PI) / static_cast<float>(numOutputBins) * (nPlusHalf + static_cast<float>(numOutputBins / 2)) * (static_cast<float>(k) + 0.5f));
+					}
 
-					auto window = MdctWindow(n, subframeWindowSize, windowMode);
-					paddedSamples[frameOffset + windowOffset + n] += sample * window;
+					auto window = MdctWindow(nPlusHalf * static_cast<float>(1 << PreviewShift), subframeWindowSize, windowMode);
+					frameSamples[windowOffset + n] += sample * window;
 				}
 			}
 		}
+	}
+
+	// Decoder implementation, shared by `Decode` and `DecodePreview`
+	//  Output is produced at 44100hz >> `PreviewShift`. Everything specific to reduced rates is compiled out when
+	//  `PreviewShift` is 0, so that `Decode` doesn't pay for it.
+	template<uint32_t PreviewShift>
+	float *DecodeImpl(const uint8_t *inputStream, uint32_t *outNumSamples)
+	{
+		// Skip tag and codec version
+		inputStream += 8;
+
+		// Determine output frame size
+		constexpr auto outputFrameSize = FrameSize >> PreviewShift;
+
+		// Read frame count, determine number of samples, and allocate output sample buffer
+		//  The frame count field also flags the stream layout
+		const auto numFramesField = *(reinterpret_cast<const uint16_t *>(inputStream));
+		inputStream += sizeof(uint16_t);
+		const auto isInterleaved = SupportsInterleavedLayout && (numFramesField & InterleavedLayoutFlag) != 0;
+		auto numFrames = static_cast<uint32_t>(SupportsInterleavedLayout ? numFramesField & MaxNumFrames : numFramesField);
+		const auto numSamples = numFrames * outputFrameSize;
+		*outNumSamples = numSamples;
+		const auto samples = new float[numSamples];
+
+		// We're going to decode one more frame than we output, so adjust the frame count
+		numFrames++;
+
+		// Set up and skip window mode and quantized band bin streams
+		//  In the interleaved layout, these are set up per frame instead, and band energies follow each frame's bins
+		auto windowModeStream = inputStream;
+		auto quantizedBandBinStream = reinterpret_cast<const int8_t *>(inputStream + numFrames);
+		if (!isInterleaved)
+			inputStream += numFrames * (1 + NumTotalBins);
+
+		// Allocate padded sample buffer, and fill with silence
+		const auto numPaddedSamples = numSamples + outputFrameSize * 2;
+		const auto paddedSamples = new float[numPaddedSamples]();
+
+		// Initialize LCG
+		uint32_t lcgState = 0;
+
+		// Clear quantized band energy predictions
+		uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+
+		// Subframe bins (see `DecodeSubframes`)
+		float windowBins[FrameSize];
+
+		// Decode frames
+		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		{
+			// Set up streams for this frame if interleaved
+			if (isInterleaved)
+			{
+				windowModeStream = inputStream;
+				quantizedBandBinStream = reinterpret_cast<const int8_t *>(inputStream + 1);
+				inputStream += 1 + NumTotalBins;
+			}
+
+			// Read window mode for this frame
+			const auto windowMode = static_cast<WindowMode>(*windowModeStream++);
+
+			// Decode subframe(s), dispatching to the kernel for the frame's subframe configuration (see `DecodeSubframes`)
+			const auto frameSamples = paddedSamples + frameIndex * outputFrameSize;
+			if constexpr (UseSpecializedDecodeKernels)
+			{
+				if (windowMode == WindowMode::Short)
+					DecodeSubframes<PreviewShift, NumShortWindowsPerFrame>(windowMode, inputStream, quantizedBandBinStream, quantizedBandEnergyPredictions, lcgState, windowBins, frameSamples);
+				else
+					DecodeSubframes<PreviewShift, 1>(windowMode, inputStream, quantizedBandBinStream, quantizedBandEnergyPredictions, lcgState, windowBins, frameSamples);
+			}
+			else
+			{
+				DecodeSubframes<PreviewShift, 0>(windowMode, inputStream, quantizedBandBinStream, quantizedBandEnergyPredictions, lcgState, windowBins, frameSamples);
+			}
+		}
 
 		// Copy samples without padding to the output buffer
-		memcpy(samples, paddedSamples + FrameSize, numSamples * sizeof(float));
+		memcpy(samples, paddedSamples + outputFrameSize, numSamples * sizeof(float));
 
 		// Free padded sample buffer
 		delete [] paddedSamples;
@@ -171,3 +394,76 @@ namespace Pulsejet
 		return samples;
 	}
 }
+
+namespace Pulsejet
+{
+	using namespace Internal;
+	using namespace Shims;
+
+	/**
+	 * Decodes an encoded pulsejet sample into a newly-allocated buffer.
+	 *
+	 * This function is optimized for size and designed to be compiled in a
+	 * size-constrained environment. In such environments, it's common not
+	 * to have access to all of the required math functions, and instead
+	 * implement them by hand. For this reason, this decoder does not
+	 * depend on any such functions directly, and instead expects that
+	 * `CosF`, `Exp2F`, `SinF`, and `SqrtF` functions are defined in the
+	 * `Pulsejet::Shims` namespace before including relevant pulsejet
+	 * header(s). pulsejet expects that these functions behave similarly
+	 * to the corresponding similarly-named cmath functions. This shim
+	 * mechanism can also be used to provide less accurate, speed-optimized
+	 * versions of these functions if desired. Batch overloads of these
+	 * shims (see `BatchShims.hpp`) are used instead when provided.
+	 *
+	 * Additionally, this function will not perform any error checking or
+	 * handling. The included metadata API can be used for high-level error
+	 * checking before decoding takes place if required (albeit not in a
+	 * non-size-constrained environment).
+	 *
+	 * @param inputStream Encoded pulsejet byte stream.
+	 * @param[out] outNumSamples Number of decoded samples.
+	 * @return Decoded samples in the [-1, 1] range (normalized).
+	 *         This buffer is allocated by `new []` and should be freed
+	 *         using `delete []`.
+	 */
+	static float *Decode(const uint8_t *inputStream, uint32_t *outNumSamples)
+	{
+		return DecodeImpl<0>(inputStream, outNumSamples);
+	}
+
+	/**
+	 * Decodes an encoded pulsejet sample into a newly-allocated buffer at a
+	 * reduced sample rate, for previews and other low-cost playback.
+	 *
+	 * Only the bands within the reduced bandwidth are decoded (bands above
+	 * it are only skipped over, advancing the noise fill generator without
+	 * synthesizing anything), and the IMDCT is evaluated at a
+	 * correspondingly reduced size, so decoding is several times faster than
+	 * `Decode`, and uses proportionally less memory. The output matches a
+	 * band-limited, decimated version of `Decode`'s output, including the
+	 * noise in noise-filled bands.
+	 *
+	 * This function has the same shim requirements as `Decode`, and likewise
+	 * doesn't perform any error checking or handling.
+	 *
+	 * @param inputStream Encoded pulsejet byte stream.
+	 * @param rateShift Output sample rate reduction, as a power of two. The
+	 *        output sample rate is 44100hz >> `rateShift`; valid values are 0
+	 *        (equivalent to `Decode`), 1 (22050hz), and 2 (11025hz).
+	 * @param[out] outNumSamples Number of decoded samples (at the reduced
+	 *             sample rate).
+	 * @return Decoded samples in the [-1, 1] range (normalized).
+	 *         This buffer is allocated by `new []` and should be freed
+	 *         using `delete []`.
+	 */
+	inline float *DecodePreview(const uint8_t *inputStream, uint32_t rateShift, uint32_t *outNumSamples)
+	{
+		switch (rateShift)
+		{
+		case 1: return DecodeImpl<1>(inputStream, outNumSamples);
+		case 2: return DecodeImpl<2>(inputStream, outNumSamples);
+		default: return DecodeImpl<0>(inputStream, outNumSamples);
+		}
+	}
+}
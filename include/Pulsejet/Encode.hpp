@@ -1,15 +1,297 @@
 #pragma once
 
+#include "BatchShims.hpp"
+#include "BitsEstimators.hpp"
 #include "Common.hpp"
 #include "EncodeHelpers.hpp"
+#include "MdctWindow.hpp"
 
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
-#include <iterator>
-#include <map>
+#include <utility>
 #include <vector>
 
+namespace Pulsejet::Internal
+{
+	using namespace Shims;
+
+	// Analysis results for a whole sample, shared by `Encode` and `EncodeBank`
+	struct SampleAnalysis
+	{
+		// Number of frames stored in the stream header (one less than the number of encoded frames)
+		uint32_t numFrames;
+		vector<uint8_t> windowModeStream;
+		vector<SubframeAnalysis> subframes;
+	};
+
+	// Number of samples in a sample's padded analysis buffer, given its number of encoded frames
+	//  The buffer holds one frame of mirrored padding on each side of the (silence-padded) encoded frames.
+	inline uint32_t NumPaddedSamples(const uint32_t numEncodedFrames)
+	{
+		return numEncodedFrames * FrameSize + FrameSize * 2;
+	}
+
+	// Fills `out` with the padded analysis buffer samples in [start, end), without building the rest of the buffer
+	//  Samples are placed one frame into the buffer and followed by silence; the head padding mirrors the first frame of
+	//  the sample, and the tail padding mirrors the last frame of the buffer (which is always silence-padded).
+	inline void ReadPaddedSamples(const float *sampleStream, const uint32_t sampleStreamSize, const uint32_t numPaddedSamples, const uint32_t start, const uint32_t end, float *out)
+	{
+		for (auto i = start; i < end; i++)
+		{
+			auto index = i;
+			if (index < FrameSize)
+				index = FrameSize * 2 - 1 - index;
+			else if (index >= numPaddedSamples - FrameSize)
+				index = (numPaddedSamples - FrameSize) * 2 - 1 - index;
+			*out++ = index - FrameSize < sampleStreamSize ? sampleStream[index - FrameSize] : 0.0f;
+		}
+	}
+
+	// Calculates the energy used for transient detection of the frame whose padded samples start at `frameSamples`
+	//  Conceptually, frames are centered around the center of each long window.
+	inline float FrameEnergy(const float *frameSamples)
+	{
+		float frameEnergy = 0.0f;
+		for (uint32_t i = 0; i < FrameSize; i++)
+		{
+			const auto sample = frameSamples[FrameSize / 2 + i];
+			frameEnergy += sample * sample;
+		}
+		return frameEnergy;
+	}
+
+	// Chooses a frame's window mode, given whether it and its neighbors are transient frames
+	inline WindowMode ChooseWindowMode(const bool isPrevFrameTransientFrame, const bool isTransientFrame, const bool isNextFrameTransientFrame, const bool useShortWindows)
+	{
+		if (!useShortWindows)
+			return WindowMode::Long;
+		if (isTransientFrame || (isPrevFrameTransientFrame && isNextFrameTransientFrame))
+			return WindowMode::Short;
+		if (isNextFrameTransientFrame)
+			return WindowMode::Start;
+		if (isPrevFrameTransientFrame)
+			return WindowMode::Stop;
+		return WindowMode::Long;
+	}
+
+	// Performs the MDCT and band energy quantization for all subframes of the frame whose padded samples start at
+	//  `frameSamples`, appending them to `outSubframes`
+	//  `quantizedBandEnergyPredictions` holds the previous subframe's quantized band energies, and is updated accordingly.
+	inline void AnalyzeFrame(const float *frameSamples, const WindowMode windowMode, uint8_t *quantizedBandEnergyPredictions, vector<SubframeAnalysis>& outSubframes)
+	{
+		// Determine subframe configuration from window mode
+		uint32_t numSubframes = 1;
+		uint32_t subframeWindowOffset = 0;
+		uint32_t subframeWindowSize = LongWindowSize;
+		if (windowMode == WindowMode::Short)
+		{
+			numSubframes = NumShortWindowsPerFrame;
+			subframeWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
+			subframeWindowSize = ShortWindowSize;
+		}
+		const auto subframeSize = subframeWindowSize / 2;
+
+		// Analyze subframe(s)
+		for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
+		{
+			SubframeAnalysis subframe;
+			subframe.numSubframes = numSubframes;
+			auto& windowBins = subframe.bins;
+			windowBins.reserve(subframeSize);
+			{
+				// Apply window
+				const auto windowOffset = subframeWindowOffset + subframeIndex * subframeSize;
+				vector<float> windowedSamples;
+				windowedSamples.reserve(subframeWindowSize);
+				for (uint32_t n = 0; n < subframeWindowSize; n++)
+				{
+					const auto sample = frameSamples[windowOffset + n];
+					const auto window = MdctWindow(n, subframeWindowSize, windowMode);
+					windowedSamples.push_back(sample * window);
+				}
+
+				// Perform MDCT
+				vector<float> cosines(subframeWindowSize);
+				for (uint32_t k = 0; k < subframeSize; k++)
+				{
+					for (uint32_t n = 0; n < subframeWindowSize; n++)
+						cosines[n] = static_cast<float>(M_PI) / static_cast<float>(subframeSize) * (static_cast<float>(n) + 0.5f + static_cast<float>(subframeSize / 2)) * (static_cast<float>(k) + 0.5f);
+					CosFBatch(cosines.data(), cosines.data(), subframeWindowSize);
+
+					float bin = 0.0f;
+					for (uint32_t n = 0; n < subframeWindowSize; n++)
+						bin += windowedSamples[n] * cosines[n];
+					windowBins.push_back(bin);
+				}
+			}
+
+			// Quantize and encode band energies
+			subframe.bandEnergyStream.reserve(NumBands);
+			auto bandBins = windowBins.data();
+			for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+			{
+				const auto numBins = BandToNumBins[bandIndex] / numSubframes;
+
+				// Calculate band energy
+				const float epsilon = 1e-27f;
+				float bandEnergy = epsilon;
+				for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+				{
+					const auto bin = bandBins[binIndex];
+					bandEnergy += bin * bin;
+				}
+				bandEnergy = sqrtf(bandEnergy);
+				subframe.bandEnergies[bandIndex] = bandEnergy;
+
+				// Quantize and encode band energy
+				const auto linearBandEnergy = (clamp(log2f(bandEnergy / static_cast<float>(numBins)), -20.0f, 20.0f) + 20.0f) / 40.0f;
+				subframe.linearBandEnergies[bandIndex] = linearBandEnergy;
+				const auto quantizedBandEnergy = static_cast<uint8_t>(roundf(linearBandEnergy * 64.0f));
+				subframe.quantizedBandEnergies[bandIndex] = quantizedBandEnergy;
+				const uint8_t quantizedBandEnergyResidual = quantizedBandEnergy - quantizedBandEnergyPredictions[bandIndex];
+				subframe.bandEnergyStream.push_back(quantizedBandEnergyResidual);
+
+				// Update quantized band energy prediction for next subframe
+				quantizedBandEnergyPredictions[bandIndex] = quantizedBandEnergy;
+
+				bandBins += numBins;
+			}
+
+			outSubframes.push_back(move(subframe));
+		}
+	}
+
+	// Chooses window modes, and performs the MDCT and band energy quantization for all subframes of a sample
+	//  None of this depends on how the subframe bins are quantized later, so it only needs to happen once per sample,
+	//  regardless of how many quantization candidates are tried.
+	inline SampleAnalysis AnalyzeSample(const float *sampleStream, const uint32_t sampleStreamSize, const bool useShortWindows)
+	{
+		SampleAnalysis analysis;
+
+		// Determine number of frames
+		auto numFrames = (sampleStreamSize + FrameSize - 1) / FrameSize;
+		analysis.numFrames = numFrames;
+
+		// We're going to decode one more frame than we output, so adjust the frame count
+		numFrames++;
+
+		// Build internal sample buffer including padding
+		const auto numPaddedSamples = NumPaddedSamples(numFrames);
+		vector<float> paddedSamples(numPaddedSamples);
+		ReadPaddedSamples(sampleStream, sampleStreamSize, numPaddedSamples, 0, numPaddedSamples, paddedSamples.data());
+
+		// Clear quantized band energy predictions
+		uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+
+		// Build transient frame map
+		vector<bool> isTransientFrameMap;
+		float lastFrameEnergy = 0.0f;
+		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		{
+			const auto frameEnergy = FrameEnergy(paddedSamples.data() + frameIndex * FrameSize);
+			isTransientFrameMap.push_back(frameEnergy >= lastFrameEnergy * 2.0f);
+			lastFrameEnergy = frameEnergy;
+		}
+
+		// Analyze frames
+		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		{
+			// Determine and output window mode for this frame
+			const auto isPrevFrameTransientFrame = frameIndex > 0 && isTransientFrameMap[frameIndex - 1];
+			const auto isNextFrameTransientFrame = frameIndex < numFrames - 1 && isTransientFrameMap[frameIndex + 1];
+			const auto windowMode = ChooseWindowMode(isPrevFrameTransientFrame, isTransientFrameMap[frameIndex], isNextFrameTransientFrame, useShortWindows);
+			analysis.windowModeStream.push_back(static_cast<uint8_t>(windowMode));
+
+			AnalyzeFrame(paddedSamples.data() + frameIndex * FrameSize, windowMode, quantizedBandEnergyPredictions, analysis.subframes);
+		}
+
+		return analysis;
+	}
+
+	// Searches (exhaustively) for the bin quantization scaling factor whose bits estimate is closest to the subframe's
+	//  target (including slack bits), storing the chosen bins in `outBinQStream`, committing them to the bits estimator,
+	//  and adjusting the slack bits accordingly
+	//  Returns the chosen bins' bits estimate, as reported by the bits estimator when committing them.
+	inline double EncodeSubframe(const SubframeAnalysis& subframe, const double targetBitsPerFrame, BitsEstimator& bitsEstimator, double& slackBits, vector<int8_t>& candidateBinQStream, vector<int8_t>& outBinQStream)
+	{
+		const auto targetBitsPerSubframe = targetBitsPerFrame / static_cast<double>(subframe.numSubframes);
+
+		double bestSubframeBitsEstimate = 0.0;
+		for (uint32_t scalingFactor = MinScalingFactor; scalingFactor <= MaxScalingFactor; scalingFactor++)
+		{
+			QuantizeSubframeBins(subframe, scalingFactor, candidateBinQStream);
+
+			// Estimate the total bits used for encoding these candidate streams
+			const auto subframeBitsEstimate = bitsEstimator.EstimateSubframe(subframe.bandEnergyStream, candidateBinQStream);
+
+			// Accept these candidate streams if this bit count estimate is closest to the target for the subframe
+			const auto targetBitsPerSubframeWithSlackBits = targetBitsPerSubframe + slackBits;
+			if (scalingFactor == MinScalingFactor || abs(subframeBitsEstimate - targetBitsPerSubframeWithSlackBits) < abs(bestSubframeBitsEstimate - targetBitsPerSubframeWithSlackBits))
+			{
+				outBinQStream = candidateBinQStream;
+				bestSubframeBitsEstimate = subframeBitsEstimate;
+			}
+		}
+
+		// Update estimator statistics with the chosen streams
+		const auto committedSubframeBitsEstimate = bitsEstimator.CommitSubframe(subframe.bandEnergyStream, outBinQStream);
+
+		// Adjust slack bits depending on our estimated bits used for this subframe
+		slackBits += targetBitsPerSubframe - bestSubframeBitsEstimate;
+
+		return committedSubframeBitsEstimate;
+	}
+
+	// Writes a complete sample stream (header and data) in the given layout, given its analysis and the quantized bins
+	//  chosen for each of its subframes
+	//  Returns an empty stream if the sample has more frames than the header can represent.
+	inline vector<uint8_t> WriteSample(const SampleAnalysis& analysis, const vector<vector<int8_t>>& subframeBinQStreams, const StreamLayout layout)
+	{
+		vector<uint8_t> v;
+		if (analysis.numFrames > MaxNumFrames)
+			return v;
+
+		// Write out tag+version number
+		WriteCString(v, SampleTag);
+		WriteU16LE(v, CodecVersionMajor);
+		WriteU16LE(v, CodecVersionMinor);
+
+		// Output number of frames and layout flag
+		auto numFramesField = static_cast<uint16_t>(analysis.numFrames);
+		if (layout == StreamLayout::Interleaved)
+			numFramesField |= InterleavedLayoutFlag;
+		WriteU16LE(v, numFramesField);
+
+		if (layout == StreamLayout::Interleaved)
+		{
+			// Output each frame's window mode, bins, and band energies together
+			size_t subframeIndex = 0;
+			for (auto windowMode : analysis.windowModeStream)
+			{
+				v.push_back(windowMode);
+				const auto numSubframes = analysis.subframes[subframeIndex].numSubframes;
+				for (uint32_t i = 0; i < numSubframes; i++)
+					v.insert(v.end(), subframeBinQStreams[subframeIndex + i].begin(), subframeBinQStreams[subframeIndex + i].end());
+				for (uint32_t i = 0; i < numSubframes; i++)
+					v.insert(v.end(), analysis.subframes[subframeIndex + i].bandEnergyStream.begin(), analysis.subframes[subframeIndex + i].bandEnergyStream.end());
+				subframeIndex += numSubframes;
+			}
+		}
+		else
+		{
+			// Concatenate streams
+			v.insert(v.end(), analysis.windowModeStream.begin(), analysis.windowModeStream.end());
+			for (const auto& binQStream : subframeBinQStreams)
+				v.insert(v.end(), binQStream.begin(), binQStream.end());
+			for (const auto& subframe : analysis.subframes)
+				v.insert(v.end(), subframe.bandEnergyStream.begin(), subframe.bandEnergyStream.end());
+		}
+
+		return v;
+	}
+}
+
 namespace Pulsejet
 {
 	using namespace Internal;
@@ -17,16 +299,83 @@ namespace Pulsejet
 
 	using namespace std;
 
+	/**
+	 * Encoder state at the end of a single frame.
+	 */
+	struct EncodeFrameState
+	{
+		/**
+		 * The frame's window mode.
+		 */
+		WindowMode windowMode;
+		/**
+		 * Quantized band energies of the frame's last subframe, from which
+		 * the next frame's band energies are predicted.
+		 */
+		uint8_t quantizedBandEnergyPredictions[NumBands];
+		/**
+		 * Rate control slack bits carried over to the next frame.
+		 */
+		double slackBits;
+		/**
+		 * Bits estimate for the frame.
+		 */
+		double bitsEstimate;
+	};
+
+	/**
+	 * Per-frame encoder state for a whole sample, saved by `Encode` (see
+	 * `EncodeOptions::state`), and used and updated by `ReEncode`.
+	 */
+	struct EncodeState
+	{
+		uint32_t sampleStreamSize = 0;
+		double sampleRate = 0.0;
+		double targetBitRate = 0.0;
+		/**
+		 * State for each encoded frame (including the extra frame past the
+		 * end of the sample).
+		 */
+		vector<EncodeFrameState> frames;
+	};
+
+	/**
+	 * Options for `Encode`.
+	 */
+	struct EncodeOptions
+	{
+		/**
+		 * Bits estimator used for rate control, and to determine the
+		 * total bits estimate. If null, an `Order0BitsEstimator` is used.
+		 * The estimator must outlive the `Encode` call.
+		 */
+		BitsEstimator *bitsEstimator = nullptr;
+		/**
+		 * Layout of the encoded stream (see `StreamLayout`). Both layouts
+		 * are read by all decoders, and decode to identical samples.
+		 */
+		StreamLayout layout = StreamLayout::Concatenated;
+		/**
+		 * If set, receives the encoder's per-frame state, which `ReEncode`
+		 * uses to re-encode edited regions of the sample without starting
+		 * over. Any previous contents are replaced.
+		 */
+		EncodeState *state = nullptr;
+	};
+
 	/**
 	 * Encodes a raw sample stream into a newly-allocated vector.
 	 *
 	 * Like `Decode`, this function expects `CosF` and `SinF` to be defined
 	 * by the user in the `Pulsejet::Shims` namespace before including the
-	 * relevant pulsejet header(s). See the documentation for `Decode` for
-	 * more information.
+	 * relevant pulsejet header(s). Batch overloads of these shims (see
+	 * `BatchShims.hpp`) are used instead when provided. See the
+	 * documentation for `Decode` for more information.
 	 *
 	 * @param sampleStream Input sample stream.
-	 * @param sampleStreamSize Input sample stream size in samples.
+	 * @param sampleStreamSize Input sample stream size in samples. At most
+	 *        `MaxNumFrames` frames of 1024 samples (a bit over 12 minutes at
+	 *        44100hz) can be encoded.
 	 * @param sampleRate Input sample rate in samples per second (hz).
 	 *        pulsejet is designed for 44100hz samples only, and its
 	 *        psychoacoustics are tuned to that rate. However, other rates
@@ -45,236 +394,77 @@ namespace Pulsejet
 	 *             encoded sample. This will typically differ slightly
 	 *             from the actual size after compression, but on average
 	 *             is accurate enough to be useful.
-	 * @return Encoded sample stream.
+	 * @param options Additional encoder options.
+	 * @return Encoded sample stream, or an empty stream if the input
+	 *         sample is too long (see `sampleStreamSize`).
 	 */
-	static vector<uint8_t> Encode(const float *sampleStream, const uint32_t sampleStreamSize, const double sampleRate, const double targetBitRate, double& outTotalBitsEstimate)
+	static vector<uint8_t> Encode(const float *sampleStream, const uint32_t sampleStreamSize, const double sampleRate, const double targetBitRate, double& outTotalBitsEstimate, const EncodeOptions& options = EncodeOptions())
 	{
-		vector<uint8_t> v;
+		// Reject samples that are too long up front, rather than analyzing them only to have `WriteSample` reject them
+		outTotalBitsEstimate = 0.0;
+		if (sampleStreamSize > MaxNumFrames * FrameSize)
+			return {};
+
+		// Set up bits estimator
+		Order0BitsEstimator defaultBitsEstimator;
+		auto& bitsEstimator = options.bitsEstimator ? *options.bitsEstimator : defaultBitsEstimator;
+		bitsEstimator.Reset();
 
 		// Determine target bits/frame
 		const auto targetBitsPerFrame = targetBitRate * 1000.0 * (static_cast<double>(FrameSize) / sampleRate);
 
-		// Write out tag+version number
-		WriteCString(v, SampleTag);
-		WriteU16LE(v, CodecVersionMajor);
-		WriteU16LE(v, CodecVersionMinor);
+		// Determine window modes and subframe bins
+		const auto analysis = AnalyzeSample(sampleStream, sampleStreamSize, targetBitRate > 8.0);
 
-		// Determine and output number of frames
-		auto numFrames = (sampleStreamSize + FrameSize - 1) / FrameSize;
-		WriteU16LE(v, static_cast<uint16_t>(numFrames));
+		// Allocate streams for each subframe's chosen bins
+		vector<vector<int8_t>> subframeBinQStreams(analysis.subframes.size());
 
-		// We're going to decode one more frame than we output, so adjust the frame count
-		numFrames++;
-
-		// Allocate internal sample buffer including padding, fill it with silence, and copy input data into it
-		const auto numSamples = numFrames * FrameSize;
-		const auto numPaddedSamples = numSamples + FrameSize * 2;
-		vector<float> paddedSamples(numPaddedSamples, 0.0f);
-		memcpy(paddedSamples.data() + FrameSize, sampleStream, sampleStreamSize * sizeof(float));
-
-		// Fill padding regions with mirrored frames from the original sample
-		for (uint32_t i = 0; i < FrameSize; i++)
+		// Set up state
+		if (options.state)
 		{
-			// Head padding
-			paddedSamples[FrameSize - 1 - i] = paddedSamples[FrameSize + i];
-			// Tail padding
-			paddedSamples[numPaddedSamples - FrameSize + i] = paddedSamples[numPaddedSamples - FrameSize - 1 - i];
+			options.state->sampleStreamSize = sampleStreamSize;
+			options.state->sampleRate = sampleRate;
+			options.state->targetBitRate = targetBitRate;
+			options.state->frames.clear();
+			options.state->frames.reserve(analysis.windowModeStream.size());
 		}
 
-		// Allocate separate streams to group correlated data
-		vector<uint8_t> windowModeStream, bandEnergyStream, binQStream;
-
-		// Clear quantized band energy predictions
-		vector<uint8_t> quantizedBandEnergyPredictions(NumBands, 0);
-
 		// Clear slack bits
 		double slackBits = 0.0;
 
 		// Clear total bits estimate
 		outTotalBitsEstimate = 0.0;
 
-		// Build transient frame map
-		vector<bool> isTransientFrameMap;
-		float lastFrameEnergy = 0.0f;
-		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
-		{
-			// Conceptually, frames are centered around the center of each long window
-			const auto frameOffset = FrameSize / 2 + frameIndex * FrameSize;
-			float frameEnergy = 0.0f;
-			for (uint32_t i = 0; i < FrameSize; i++)
-			{
-				const auto sample = paddedSamples[frameOffset + i];
-				frameEnergy += sample * sample;
-			}
-			isTransientFrameMap.push_back(frameEnergy >= lastFrameEnergy * 2.0f);
-			lastFrameEnergy = frameEnergy;
-		}
-
 		// Encode frames
-		for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		vector<int8_t> candidateBinQStream;
+		candidateBinQStream.reserve(FrameSize);
+		size_t subframeIndex = 0;
+		for (auto windowMode : analysis.windowModeStream)
 		{
-			// Determine and output window mode for this frame
-			const auto isTransientFrame = isTransientFrameMap[frameIndex];
-			WindowMode windowMode = WindowMode::Long;
-			if (targetBitRate > 8.0)
+			const auto numSubframes = analysis.subframes[subframeIndex].numSubframes;
+			double frameBitsEstimate = 0.0;
+			for (uint32_t i = 0; i < numSubframes; i++, subframeIndex++)
 			{
-				const auto isPrevFrameTransientFrame = frameIndex > 0 && isTransientFrameMap[frameIndex - 1];
-				const auto isNextFrameTransientFrame = frameIndex < numFrames - 1 && isTransientFrameMap[frameIndex + 1];
-				if (isTransientFrame || (isPrevFrameTransientFrame && isNextFrameTransientFrame))
-				{
-					windowMode = WindowMode::Short;
-				}
-				else if (isNextFrameTransientFrame)
-				{
-					windowMode = WindowMode::Start;
-				}
-				else if (isPrevFrameTransientFrame)
-				{
-					windowMode = WindowMode::Stop;
-				}
-			}
-			windowModeStream.push_back(static_cast<uint8_t>(windowMode));
+				const auto subframeBitsEstimate = EncodeSubframe(analysis.subframes[subframeIndex], targetBitsPerFrame, bitsEstimator, slackBits, candidateBinQStream, subframeBinQStreams[subframeIndex]);
+				frameBitsEstimate += subframeBitsEstimate;
 
-			// Determine subframe configuration from window mode
-			uint32_t numSubframes = 1;
-			uint32_t subframeWindowOffset = 0;
-			uint32_t subframeWindowSize = LongWindowSize;
-			if (windowMode == WindowMode::Short)
-			{
-				numSubframes = NumShortWindowsPerFrame;
-				subframeWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
-				subframeWindowSize = ShortWindowSize;
+				// Update total bits estimate
+				outTotalBitsEstimate += subframeBitsEstimate;
 			}
-			const auto subframeSize = subframeWindowSize / 2;
 
-			const auto targetBitsPerSubframe = targetBitsPerFrame / static_cast<double>(numSubframes);
-
-			// Encode subframe(s)
-			for (uint32_t subframeIndex = 0; subframeIndex < numSubframes; subframeIndex++)
+			if (options.state)
 			{
-				vector<float> windowBins;
-				windowBins.reserve(subframeSize);
-				{
-					// Apply window
-					const auto frameOffset = frameIndex * FrameSize;
-					const auto windowOffset = subframeWindowOffset + subframeIndex * subframeSize;
-					vector<float> windowedSamples;
-					windowedSamples.reserve(subframeWindowSize);
-					for (uint32_t n = 0; n < subframeWindowSize; n++)
-					{
-						const auto sample = paddedSamples[frameOffset + windowOffset + n];
-						const auto window = MdctWindow(n, subframeWindowSize, windowMode);
-						windowedSamples.push_back(sample * window);
-					}
-
-					// Perform MDCT
-					for (uint32_t k = 0; k < subframeSize; k++)
-					{
-						float bin = 0.0f;
-						for (uint32_t n = 0; n < subframeWindowSize; n++)
-							bin += windowedSamples[n] * CosF(static_cast<float>(M_PI) / static_cast<float>(subframeSize) * (static_cast<float>(n) + 0.5f + static_cast<float>(subframeSize / 2)) * (static_cast<float>(k) + 0.5f));
-						windowBins.push_back(bin);
-					}
-				}
-
-				// Search (exhaustively) for an appropriate bin quantization scaling factor
-				vector<uint8_t> bestQuantizedBandEnergies;
-				vector<uint8_t> bestBandEnergyStream;
-				vector<int8_t> bestBinQStream;
-				double bestSubframeBitsEstimate = 0.0;
-
-				const uint32_t minScalingFactor = 1;
-				const uint32_t maxScalingFactor = 500;
-				for (uint32_t scalingFactor = minScalingFactor; scalingFactor <= maxScalingFactor; scalingFactor++)
-				{
-					vector<uint8_t> candidateQuantizedBandEnergies;
-					vector<uint8_t> candidateBandEnergyStream;
-					candidateQuantizedBandEnergies.reserve(NumBands);
-					candidateBandEnergyStream.reserve(NumBands);
-					map<uint8_t, uint32_t> candidateBandEnergyFreqs;
-					vector<int8_t> candidateBinQStream;
-					candidateBinQStream.reserve(subframeSize);
-					map<int8_t, uint32_t> candidateBinQFreqs;
-
-					// Encode bands
-					auto bandBins = windowBins.data();
-					for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
-					{
-						const auto numBins = BandToNumBins[bandIndex] / numSubframes;
-
-						// Calculate band energy
-						const float epsilon = 1e-27f;
-						float bandEnergy = epsilon;
-						for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
-						{
-							const auto bin = bandBins[binIndex];
-							bandEnergy += bin * bin;
-						}
-						bandEnergy = sqrtf(bandEnergy);
-
-						// Quantize and encode band energy
-						const auto linearBandEnergy = (clamp(log2f(bandEnergy / static_cast<float>(numBins)), -20.0f, 20.0f) + 20.0f) / 40.0f;
-						const auto quantizedBandEnergy = static_cast<uint8_t>(roundf(linearBandEnergy * 64.0f));
-						candidateQuantizedBandEnergies.push_back(quantizedBandEnergy);
-						const uint8_t quantizedBandEnergyResidual = quantizedBandEnergy - quantizedBandEnergyPredictions[bandIndex];
-						candidateBandEnergyStream.push_back(quantizedBandEnergyResidual);
-						candidateBandEnergyFreqs.try_emplace(quantizedBandEnergyResidual, 0);
-						candidateBandEnergyFreqs.at(quantizedBandEnergyResidual) += 1;
-
-						// Determine band bin quantization scale
-						const auto bandBinQuantizeScale = powf(static_cast<float>(BandBinQuantizeScaleBases[bandIndex]) / 200.0f, 3.0f) * static_cast<float>(scalingFactor) / static_cast<float>(maxScalingFactor) * 127.0f * linearBandEnergy * linearBandEnergy;
-
-						// Normalize, quantize, and encode band bins
-						for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
-						{
-							const auto bin = bandBins[binIndex];
-							const auto binQ = static_cast<int8_t>(roundf(bin / (bandEnergy + epsilon) * bandBinQuantizeScale));
-							candidateBinQStream.push_back(binQ);
-							candidateBinQFreqs.try_emplace(binQ, 0);
-							candidateBinQFreqs.at(binQ) += 1;
-						}
-
-						bandBins += numBins;
-					}
-
-					// Model the order 0 entropy of the quantized stream symbols in order to estimate the total bits used for encoding
-					//  Also adjust estimate slightly, as squishy (and likely other compressors) tend to find additional correlations not captured by this simple model
-					const auto bandEnergyBitsEstimate = Order0BitsEstimate(candidateBandEnergyFreqs);
-					const auto binQBitsEstimate = Order0BitsEstimate(candidateBinQFreqs);
-					const double estimateAdjustment = 0.83;
-					const auto subframeBitsEstimate = (bandEnergyBitsEstimate + binQBitsEstimate) * estimateAdjustment;
-
-					// Accept these candidate streams if this bit count estimate is closest to the target for the subframe
-					const auto targetBitsPerSubframeWithSlackBits = targetBitsPerSubframe + slackBits;
-					if (scalingFactor == minScalingFactor || abs(subframeBitsEstimate - targetBitsPerSubframeWithSlackBits) < abs(bestSubframeBitsEstimate - targetBitsPerSubframeWithSlackBits))
-					{
-						bestQuantizedBandEnergies = candidateQuantizedBandEnergies;
-						bestBandEnergyStream = candidateBandEnergyStream;
-						bestBinQStream = candidateBinQStream;
-						bestSubframeBitsEstimate = subframeBitsEstimate;
-					}
-				}
-
-				// Update quantized band energy predictions for next subframe
-				quantizedBandEnergyPredictions = bestQuantizedBandEnergies;
-
-				// Output the best-performing parameters/coefficients to their respective streams
-				move(bestBandEnergyStream.begin(), bestBandEnergyStream.end(), back_inserter(bandEnergyStream));
-				move(bestBinQStream.begin(), bestBinQStream.end(), back_inserter(binQStream));
-
-				// Adjust slack bits depending on our estimated bits used for this subframe
-				slackBits += targetBitsPerSubframe - bestSubframeBitsEstimate;
-
-				// Update total bits estimate
-				outTotalBitsEstimate += bestSubframeBitsEstimate;
+				EncodeFrameState frameState;
+				frameState.windowMode = static_cast<WindowMode>(windowMode);
+				const auto& lastSubframe = analysis.subframes[subframeIndex - 1];
+				copy(begin(lastSubframe.quantizedBandEnergies), end(lastSubframe.quantizedBandEnergies), frameState.quantizedBandEnergyPredictions);
+				frameState.slackBits = slackBits;
+				frameState.bitsEstimate = frameBitsEstimate;
+				options.state->frames.push_back(frameState);
 			}
 		}
 
-		// Concatenate streams
-		move(windowModeStream.begin(), windowModeStream.end(), back_inserter(v));
-		move(binQStream.begin(), binQStream.end(), back_inserter(v));
-		move(bandEnergyStream.begin(), bandEnergyStream.end(), back_inserter(v));
-
-		return v;
+		// Write out header and streams
+		return WriteSample(analysis, subframeBinQStreams, options.layout);
 	}
 }
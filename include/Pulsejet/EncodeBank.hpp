@@ -0,0 +1,449 @@
+#pragma once
+
+#include "BitsEstimators.hpp"
+#include "Common.hpp"
+#include "Encode.hpp"
+#include "EncodeHelpers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace Pulsejet::Internal
+{
+	using namespace std;
+
+	// A candidate quantization for a subframe, with its estimated rate and (weighted) distortion
+	struct RateDistortionPoint
+	{
+		uint32_t scalingFactor;
+		double bits;
+		double distortion;
+	};
+
+	// Per-sample bank encoder state, which is computed once and reused across allocation iterations
+	struct BankSampleState
+	{
+		SampleAnalysis analysis;
+		// Lower convex hull of each subframe's rate/distortion candidates, ordered by increasing bits
+		vector<vector<RateDistortionPoint>> subframeCurves;
+		// Estimated bits for everything besides the subframes themselves (header, window modes)
+		double overheadBits;
+		// Ratio of measured to estimated compressed size, which corrects the sample's bit estimates
+		double rateScale = 1.0;
+	};
+
+	// Reduces a set of rate/distortion candidates to their lower convex hull
+	//  Only points on the hull can be optimal for some rate/distortion tradeoff, so nothing else needs to be kept.
+	inline vector<RateDistortionPoint> RateDistortionHull(vector<RateDistortionPoint> points)
+	{
+		sort(points.begin(), points.end(), [](const auto& a, const auto& b)
+		{
+			return a.bits < b.bits || (a.bits == b.bits && a.distortion < b.distortion);
+		});
+
+		vector<RateDistortionPoint> hull;
+		for (const auto& point : points)
+		{
+			// Points that don't reduce distortion are never worth their bits
+			if (!hull.empty() && point.distortion >= hull.back().distortion)
+				continue;
+
+			// Remove points that are above the segment between their neighbors
+			while (hull.size() >= 2)
+			{
+				const auto& a = hull[hull.size() - 2];
+				const auto& b = hull.back();
+				const auto cross = (b.bits - a.bits) * (point.distortion - a.distortion) - (b.distortion - a.distortion) * (point.bits - a.bits);
+				if (cross > 0.0)
+					break;
+				hull.pop_back();
+			}
+			hull.push_back(point);
+		}
+		return hull;
+	}
+
+	// Picks the point minimizing `distortion + lambda * bits` on a hull
+	inline const RateDistortionPoint& SelectRateDistortionPoint(const vector<RateDistortionPoint>& hull, const double lambda)
+	{
+		// Costs along a convex hull are unimodal, so we can stop as soon as they stop decreasing
+		size_t bestIndex = 0;
+		auto bestCost = hull[0].distortion + lambda * hull[0].bits;
+		for (size_t i = 1; i < hull.size(); i++)
+		{
+			const auto cost = hull[i].distortion + lambda * hull[i].bits;
+			if (cost >= bestCost)
+				break;
+			bestIndex = i;
+			bestCost = cost;
+		}
+		return hull[bestIndex];
+	}
+
+	inline double AllocatedBits(const vector<BankSampleState>& states, const double lambda)
+	{
+		double bits = 0.0;
+		for (const auto& state : states)
+		{
+			double sampleBits = state.overheadBits;
+			for (const auto& curve : state.subframeCurves)
+				sampleBits += SelectRateDistortionPoint(curve, lambda * state.rateScale).bits;
+			bits += sampleBits * state.rateScale;
+		}
+		return bits;
+	}
+
+	// Finds the tradeoff that spends as many (estimated) bits as possible without exceeding `targetBits`
+	inline double AllocateBits(const vector<BankSampleState>& states, const double targetBits)
+	{
+		// Distortions are normalized per sample, so a wide, fixed lambda range covers all relevant tradeoffs
+		const double minLogLambda = -60.0;
+		const double maxLogLambda = 20.0;
+		if (AllocatedBits(states, exp2(minLogLambda)) <= targetBits)
+			return exp2(minLogLambda);
+
+		// Bits decrease monotonically with lambda, so bisect (in the log domain) for the smallest lambda that fits
+		auto lowLogLambda = minLogLambda;
+		auto highLogLambda = maxLogLambda;
+		for (uint32_t i = 0; i < 64; i++)
+		{
+			const auto logLambda = (lowLogLambda + highLogLambda) * 0.5;
+			if (AllocatedBits(states, exp2(logLambda)) <= targetBits)
+			{
+				highLogLambda = logLambda;
+			}
+			else
+			{
+				lowLogLambda = logLambda;
+			}
+		}
+		return exp2(highLogLambda);
+	}
+
+	// Builds a sample's stream using the allocation for `lambda`, and re-estimates its bits with the chosen candidates
+	inline vector<uint8_t> WriteBankSample(const BankSampleState& state, const double lambda, const StreamLayout layout, BitsEstimator& bitsEstimator, double& outBitsEstimate)
+	{
+		bitsEstimator.Reset();
+		outBitsEstimate = state.overheadBits;
+
+		vector<vector<int8_t>> subframeBinQStreams(state.analysis.subframes.size());
+		for (size_t i = 0; i < state.analysis.subframes.size(); i++)
+		{
+			const auto& subframe = state.analysis.subframes[i];
+			const auto& point = SelectRateDistortionPoint(state.subframeCurves[i], lambda * state.rateScale);
+			QuantizeSubframeBins(subframe, point.scalingFactor, subframeBinQStreams[i]);
+
+			outBitsEstimate += bitsEstimator.CommitSubframe(subframe.bandEnergyStream, subframeBinQStreams[i]);
+		}
+
+		return WriteSample(state.analysis, subframeBinQStreams, layout);
+	}
+}
+
+namespace Pulsejet
+{
+	using namespace Internal;
+
+	using namespace std;
+
+	/**
+	 * A sample to be encoded as part of a bank with `EncodeBank`.
+	 */
+	struct BankSample
+	{
+		/**
+		 * Input sample stream.
+		 */
+		const float *sampleStream;
+		/**
+		 * Input sample stream size in samples. Samples longer than `Encode`
+		 * accepts are encoded as empty streams.
+		 */
+		uint32_t sampleStreamSize;
+		/**
+		 * Input sample rate in samples per second (hz). See `Encode`.
+		 */
+		double sampleRate = 44100.0;
+		/**
+		 * Relative importance of this sample's quality. A sample with
+		 * weight 2 is treated as if it were two identical samples, ie. its
+		 * quality is worth twice as many bits as that of a sample with
+		 * weight 1.
+		 */
+		double weight = 1.0;
+	};
+
+	/**
+	 * Options for `EncodeBank`.
+	 */
+	struct BankEncodeOptions
+	{
+		/**
+		 * Bits estimator used for rate/distortion analysis, and to
+		 * determine the total bits estimate. If null, an
+		 * `Order0BitsEstimator` is used. The estimator must outlive the
+		 * `EncodeBank` call.
+		 */
+		BitsEstimator *bitsEstimator = nullptr;
+		/**
+		 * Optional function which measures the actual size in bytes of the
+		 * bank after compression, for example by running it through the
+		 * packer used in production. If provided, the allocation is
+		 * iteratively corrected until this size meets the byte budget,
+		 * rather than relying on bits estimates alone.
+		 */
+		function<size_t(const vector<vector<uint8_t>>& encodedSamples)> measureCompressedSize;
+		/**
+		 * If set, the first allocation is also measured per sample with
+		 * `measureCompressedSize`, and the result is used to calibrate each
+		 * sample's bits estimates before reallocating. This costs one
+		 * extra measurement per sample, but typically improves the
+		 * allocation substantially, as estimates tend to be off by
+		 * different amounts for different material.
+		 */
+		bool calibrateSamples = true;
+		/**
+		 * Maximum number of bank measurements made with
+		 * `measureCompressedSize` (not counting per-sample calibration).
+		 */
+		uint32_t maxMeasurements = 8;
+		/**
+		 * Measured sizes within this fraction below the byte budget are
+		 * accepted without further iterations.
+		 */
+		double budgetTolerance = 0.01;
+		/**
+		 * Layout of the encoded sample streams (see `StreamLayout`).
+		 */
+		StreamLayout layout = StreamLayout::Concatenated;
+	};
+
+	/**
+	 * Result of `EncodeBank`.
+	 */
+	struct BankEncodeResult
+	{
+		/**
+		 * Encoded sample streams, in the same order as the input samples.
+		 */
+		vector<vector<uint8_t>> encodedSamples;
+		/**
+		 * Total bits estimate for each encoded sample (see `Encode`).
+		 */
+		vector<double> bitsEstimates;
+		/**
+		 * Total bits estimate for the whole bank.
+		 */
+		double totalBitsEstimate = 0.0;
+		/**
+		 * Compressed size of the whole bank in bytes, as measured by
+		 * `BankEncodeOptions::measureCompressedSize`, or 0 if it wasn't
+		 * provided.
+		 */
+		size_t compressedSize = 0;
+		/**
+		 * Whether the byte budget was met (measured if possible, estimated
+		 * otherwise). Without `BankEncodeOptions::measureCompressedSize`,
+		 * this is only false if even the lowest possible quality for all
+		 * samples doesn't fit. With it, this is also false if the measured
+		 * size still exceeded the budget after
+		 * `BankEncodeOptions::maxMeasurements` measurements, in which case
+		 * the smallest measured result is returned; raising
+		 * `maxMeasurements` or passing a slightly lower budget fixes this.
+		 */
+		bool metBudget = false;
+	};
+
+	/**
+	 * Encodes a bank of samples such that their total compressed size fits
+	 * a byte budget, distributing bits across (and within) samples where
+	 * they reduce distortion the most.
+	 *
+	 * Each sample is analyzed once, and for each of its subframes, the
+	 * estimated bits and distortion of every bin quantization candidate
+	 * are recorded. Distortion is measured as log noise-to-signal ratios
+	 * per band, weighted according to the codec's noise shaping, and
+	 * averaged over the whole sample (so it doesn't depend on a sample's
+	 * length or level), scaled by the sample's weight. Bits are then
+	 * allocated across all subframes of all samples by finding the single
+	 * rate/distortion tradeoff (Lagrange multiplier) for which the bank's
+	 * total bits estimate just fits the budget, so the marginal quality
+	 * benefit per bit is the same everywhere. If
+	 * `BankEncodeOptions::measureCompressedSize` is provided, each
+	 * sample's estimates are calibrated against its measured size, and
+	 * the target is then corrected by the ratio of the measured size to
+	 * the budget until the measured size fits (or the measurements run
+	 * out; see `BankEncodeResult::metBudget`). These iterations only
+	 * repeat the (cheap) allocation, not the analysis.
+	 *
+	 * Since the effective bit rate isn't known up front, window modes are
+	 * chosen as `Encode` would for the bank's average bit rate. Stateful
+	 * bits estimators (eg. `ContextBitsEstimator`) are driven during
+	 * analysis as if each sample were encoded at that average rate, which
+	 * the final allocation may deviate from, so their per-candidate
+	 * estimates are somewhat less accurate than with `Encode`.
+	 *
+	 * This function has the same shim requirements as `Encode`.
+	 *
+	 * @param samples Samples to encode.
+	 * @param byteBudget Total compressed size budget for all samples, in
+	 *        bytes.
+	 * @param options Additional encoder options.
+	 * @return Encoded samples and size information.
+	 */
+	inline BankEncodeResult EncodeBank(const vector<BankSample>& samples, const size_t byteBudget, const BankEncodeOptions& options = BankEncodeOptions())
+	{
+		BankEncodeResult result;
+		if (samples.empty())
+		{
+			result.metBudget = true;
+			return result;
+		}
+
+		// Set up bits estimator
+		Order0BitsEstimator defaultBitsEstimator;
+		auto& bitsEstimator = options.bitsEstimator ? *options.bitsEstimator : defaultBitsEstimator;
+
+		// Determine the bank's average bit rate, which is used to choose window modes
+		const auto budgetBits = static_cast<double>(byteBudget) * 8.0;
+		double totalDuration = 0.0;
+		for (const auto& sample : samples)
+			totalDuration += static_cast<double>(sample.sampleStreamSize) / sample.sampleRate;
+		const auto averageBitRate = totalDuration > 0.0 ? budgetBits / 1000.0 / totalDuration : 0.0;
+
+		// Analyze samples and build rate/distortion curves for all of their subframes
+		vector<BankSampleState> states;
+		states.reserve(samples.size());
+		vector<RateDistortionPoint> points;
+		points.reserve(MaxScalingFactor - MinScalingFactor + 1);
+		vector<int8_t> candidateBinQStream;
+		candidateBinQStream.reserve(FrameSize);
+		for (const auto& sample : samples)
+		{
+			BankSampleState state;
+			state.analysis = AnalyzeSample(sample.sampleStream, sample.sampleStreamSize, averageBitRate > 8.0);
+
+			// Header and window modes are the same for all candidates
+			map<uint8_t, uint32_t> windowModeFreqs;
+			for (auto symbol : state.analysis.windowModeStream)
+				windowModeFreqs[symbol]++;
+			state.overheadBits = (4 + sizeof(uint16_t) * 3) * 8.0 + Order0BitsEstimate(windowModeFreqs);
+
+			// Normalize distortions by the sample's total perceptual weight, so that each sample's distortion is a weighted
+			//  mean over its bands and subframes, which doesn't depend on its length or how much of it is silent
+			double sampleDistortionWeight = 0.0;
+			for (const auto& subframe : state.analysis.subframes)
+			{
+				for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+					sampleDistortionWeight += BandDistortionWeight(subframe, bandIndex);
+			}
+			const auto distortionScale = sample.weight / max(sampleDistortionWeight, 1e-20);
+
+			// Estimator state evolves as if the sample were encoded at the average rate (like `Encode`)
+			const auto targetBitsPerFrame = averageBitRate * 1000.0 * (static_cast<double>(FrameSize) / sample.sampleRate);
+			double slackBits = 0.0;
+			bitsEstimator.Reset();
+
+			vector<int8_t> commitBinQStream;
+			for (const auto& subframe : state.analysis.subframes)
+			{
+				const auto targetBitsPerSubframeWithSlackBits = targetBitsPerFrame / static_cast<double>(subframe.numSubframes) + slackBits;
+
+				points.clear();
+				size_t commitIndex = 0;
+				for (uint32_t scalingFactor = MinScalingFactor; scalingFactor <= MaxScalingFactor; scalingFactor++)
+				{
+					QuantizeSubframeBins(subframe, scalingFactor, candidateBinQStream);
+					const auto bits = bitsEstimator.EstimateSubframe(subframe.bandEnergyStream, candidateBinQStream);
+					const auto distortion = SubframeDistortion(subframe, candidateBinQStream) * distortionScale;
+					points.push_back({ scalingFactor, bits, distortion });
+
+					if (abs(bits - targetBitsPerSubframeWithSlackBits) < abs(points[commitIndex].bits - targetBitsPerSubframeWithSlackBits))
+						commitIndex = points.size() - 1;
+				}
+
+				QuantizeSubframeBins(subframe, points[commitIndex].scalingFactor, commitBinQStream);
+				bitsEstimator.CommitSubframe(subframe.bandEnergyStream, commitBinQStream);
+				slackBits = targetBitsPerSubframeWithSlackBits - points[commitIndex].bits;
+
+				state.subframeCurves.push_back(RateDistortionHull(points));
+			}
+
+			states.push_back(move(state));
+		}
+
+		// Allocate bits, and (if possible) correct the target by measuring the actual compressed size
+		auto targetBits = budgetBits;
+		const auto numMeasurements = options.measureCompressedSize ? max(options.maxMeasurements, 1u) : 1u;
+		for (uint32_t measurementIndex = 0; measurementIndex < numMeasurements; measurementIndex++)
+		{
+			const auto lambda = AllocateBits(states, targetBits);
+
+			BankEncodeResult candidate;
+			for (const auto& state : states)
+			{
+				double bitsEstimate;
+				candidate.encodedSamples.push_back(WriteBankSample(state, lambda, options.layout, bitsEstimator, bitsEstimate));
+				candidate.bitsEstimates.push_back(bitsEstimate);
+				candidate.totalBitsEstimate += bitsEstimate;
+			}
+
+			double size;
+			if (options.measureCompressedSize)
+			{
+				candidate.compressedSize = options.measureCompressedSize(candidate.encodedSamples);
+				size = static_cast<double>(candidate.compressedSize);
+			}
+			else
+			{
+				size = ceil(candidate.totalBitsEstimate / 8.0);
+			}
+			candidate.metBudget = size <= static_cast<double>(byteBudget);
+
+			// Keep the largest result that fits, or failing that, the smallest one
+			const auto isBetter =
+				measurementIndex == 0 ||
+				(candidate.metBudget && (!result.metBudget || candidate.compressedSize > result.compressedSize)) ||
+				(!candidate.metBudget && !result.metBudget && candidate.compressedSize < result.compressedSize);
+			if (isBetter)
+				result = move(candidate);
+
+			if (!options.measureCompressedSize || size <= 0.0)
+				break;
+
+			// After the first measurement, calibrate each sample's estimates against its own compressed size, as estimates
+			//  are typically off by different amounts for different material (eg. packers exploit repetition in tonal
+			//  material much better than our estimators model). The target then accounts for the difference between the
+			//  bank's compressed size and the sum of its samples' sizes (eg. due to redundancy across samples).
+			if (measurementIndex == 0 && options.calibrateSamples)
+			{
+				double sumOfSampleSizes = 0.0;
+				for (size_t i = 0; i < states.size(); i++)
+				{
+					const auto sampleSize = static_cast<double>(options.measureCompressedSize({ result.encodedSamples[i] }));
+					if (sampleSize > 0.0 && result.bitsEstimates[i] > 0.0)
+						states[i].rateScale = sampleSize * 8.0 / result.bitsEstimates[i];
+					sumOfSampleSizes += sampleSize;
+				}
+				targetBits = budgetBits * sumOfSampleSizes / size;
+				continue;
+			}
+
+			if (result.metBudget && static_cast<double>(result.compressedSize) >= static_cast<double>(byteBudget) * (1.0 - options.budgetTolerance))
+				break;
+
+			// Scale the target by how far off the measurement was, aiming slightly low when over budget
+			auto correction = static_cast<double>(byteBudget) / size;
+			if (correction < 1.0)
+				correction *= 1.0 - options.budgetTolerance * 0.5;
+			targetBits *= correction;
+		}
+
+		return result;
+	}
+}
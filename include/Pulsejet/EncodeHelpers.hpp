@@ -2,8 +2,12 @@
 
 #include "Common.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdint>
 #include <map>
+#include <utility>
 #include <vector>
 
 namespace Pulsejet::Internal
@@ -34,6 +38,263 @@ namespace Pulsejet::Internal
 		return bitsEstimate;
 	}
 
+	// Estimates the (unadjusted) order 0 entropy of one of a subframe's streams, in bits
+	template<typename Symbol>
+	double Order0StreamBitsEstimate(const vector<Symbol>& stream)
+	{
+		map<Symbol, uint32_t> freqs;
+		for (auto symbol : stream)
+		{
+			freqs.try_emplace(symbol, 0);
+			freqs.at(symbol) += 1;
+		}
+		return Order0BitsEstimate(freqs);
+	}
+
+	// Estimates the (unadjusted) order 0 entropy of a subframe's band energy and quantized band bin streams, in bits
+	inline double Order0SubframeBitsEstimate(const vector<uint8_t>& bandEnergyStream, const vector<int8_t>& binQStream)
+	{
+		return Order0StreamBitsEstimate(bandEnergyStream) + Order0StreamBitsEstimate(binQStream);
+	}
+
+	inline constexpr uint32_t MinScalingFactor = 1;
+	inline constexpr uint32_t MaxScalingFactor = 500;
+
+	// Analysis results for a single subframe, which don't depend on the bin quantization scaling factor chosen for it
+	struct SubframeAnalysis
+	{
+		uint32_t numSubframes;
+		vector<float> bins;
+		float bandEnergies[NumBands];
+		float linearBandEnergies[NumBands];
+		uint8_t quantizedBandEnergies[NumBands];
+		vector<uint8_t> bandEnergyStream;
+	};
+
+	// `powf(BandBinQuantizeScaleBases[bandIndex] / 200, 3)` for each band, which is evaluated once rather than for each
+	//  quantization candidate
+	inline const float *BandBinQuantizeScaleBasesCubed()
+	{
+		static const auto table = []
+		{
+			array<float, NumBands> ret;
+			for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+				ret[bandIndex] = powf(static_cast<float>(BandBinQuantizeScaleBases[bandIndex]) / 200.0f, 3.0f);
+			return ret;
+		}();
+		return table.data();
+	}
+
+	// Calls `Kernel<NumSubframes>` for the given number of subframes, so that band sizes and loop trip counts in the
+	//  encoder's band loops are compile-time constants for both long and short subframes
+	template<template<uint32_t> class Kernel, typename... Args>
+	auto DispatchNumSubframes(const uint32_t numSubframes, Args&&... args)
+	{
+		if (numSubframes == NumShortWindowsPerFrame)
+			return Kernel<NumShortWindowsPerFrame>::Run(forward<Args>(args)...);
+		return Kernel<1>::Run(forward<Args>(args)...);
+	}
+
+	template<uint32_t NumSubframes>
+	struct QuantizeSubframeBinsKernel
+	{
+		static void Run(const SubframeAnalysis& subframe, const uint32_t scalingFactor, int8_t *outBinQs)
+		{
+			const auto bandBinQuantizeScaleBasesCubed = BandBinQuantizeScaleBasesCubed();
+			auto bandBins = subframe.bins.data();
+			for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+			{
+				const auto numBins = BandToNumBins[bandIndex] / NumSubframes;
+				const auto bandEnergy = subframe.bandEnergies[bandIndex];
+				const auto linearBandEnergy = subframe.linearBandEnergies[bandIndex];
+
+				// Determine band bin quantization scale
+				const auto bandBinQuantizeScale = bandBinQuantizeScaleBasesCubed[bandIndex] * static_cast<float>(scalingFactor) / static_cast<float>(MaxScalingFactor) * 127.0f * linearBandEnergy * linearBandEnergy;
+
+				// Normalize and quantize band bins
+				const float epsilon = 1e-27f;
+				for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+				{
+					const auto bin = bandBins[binIndex];
+					*outBinQs++ = static_cast<int8_t>(roundf(bin / (bandEnergy + epsilon) * bandBinQuantizeScale));
+				}
+
+				bandBins += numBins;
+			}
+		}
+	};
+
+	// Quantizes a subframe's bins with the given scaling factor into `outBinQStream`
+	inline void QuantizeSubframeBins(const SubframeAnalysis& subframe, const uint32_t scalingFactor, vector<int8_t>& outBinQStream)
+	{
+		outBinQStream.resize(NumTotalBins / subframe.numSubframes);
+		DispatchNumSubframes<QuantizeSubframeBinsKernel>(subframe.numSubframes, subframe, scalingFactor, outBinQStream.data());
+	}
+
+	// Perceptual weight of a subframe band's coding error
+	//  The encoder's bin quantization scale is proportional to `BandBinQuantizeScaleBases[bandIndex]^3 * linearBandEnergy^2`,
+	//  so (for a given scaling factor) the resulting noise-to-signal power ratio is inversely proportional to the square of
+	//  that. Weighting noise-to-signal ratios by it reproduces the noise shaping the codec is designed around, and leaves
+	//  (near-)silent bands with negligible weight.
+	inline double BandDistortionWeight(const SubframeAnalysis& subframe, const uint32_t bandIndex)
+	{
+		const auto scaleBase = static_cast<double>(BandBinQuantizeScaleBases[bandIndex]) / 200.0;
+		const auto linearBandEnergy = static_cast<double>(subframe.linearBandEnergies[bandIndex]);
+		const auto scale = scaleBase * scaleBase * scaleBase * linearBandEnergy * linearBandEnergy;
+		return scale * scale / static_cast<double>(subframe.numSubframes);
+	}
+
+	template<uint32_t NumSubframes>
+	struct SubframeDistortionKernel
+	{
+		static double Run(const SubframeAnalysis& subframe, const int8_t *binQs)
+		{
+			double distortion = 0.0;
+			auto bandBins = subframe.bins.data();
+			auto bandBinQs = binQs;
+			for (uint32_t bandIndex = 0; bandIndex < NumBands; bandIndex++)
+			{
+				const auto numBins = BandToNumBins[bandIndex] / NumSubframes;
+
+				double binEnergy = 0.0;
+				double binQEnergy = 0.0;
+				double binCorrelation = 0.0;
+				uint32_t numNonzeroBins = 0;
+				for (uint32_t binIndex = 0; binIndex < numBins; binIndex++)
+				{
+					const auto bin = static_cast<double>(bandBins[binIndex]);
+					const auto binQ = static_cast<double>(bandBinQs[binIndex]);
+					if (bandBinQs[binIndex])
+						numNonzeroBins++;
+					binEnergy += bin * bin;
+					binQEnergy += binQ * binQ;
+					binCorrelation += bin * binQ;
+				}
+
+				// Add expected noise fill energy (noise samples are roughly uniform in [-1, 1], so their mean energy is ~1/3)
+				const auto binFill = static_cast<double>(numNonzeroBins) / static_cast<double>(numBins);
+				const auto noiseFillThreshold = 0.1;
+				if (binFill < noiseFillThreshold)
+				{
+					const auto binSparsity = (noiseFillThreshold - binFill) / noiseFillThreshold;
+					const auto noiseFillGain = binSparsity * binSparsity;
+					binQEnergy += static_cast<double>(numBins) * noiseFillGain * noiseFillGain / 3.0;
+				}
+
+				// The decoder normalizes the band bins and scales them by the decoded band energy
+				const auto decodedBandEnergy = exp2(static_cast<double>(subframe.quantizedBandEnergies[bandIndex]) / 64.0 * 40.0 - 20.0) * static_cast<double>(numBins);
+				const auto projection = binQEnergy > 0.0 ? binCorrelation / sqrt(binQEnergy) : 0.0;
+				const auto errorEnergy = max(binEnergy + decodedBandEnergy * decodedBandEnergy - 2.0 * decodedBandEnergy * projection, 0.0);
+
+				const double epsilon = 1e-30;
+				distortion += BandDistortionWeight(subframe, bandIndex) * log2((errorEnergy + binEnergy * 1e-6 + epsilon) / (binEnergy + epsilon));
+
+				bandBins += numBins;
+				bandBinQs += numBins;
+			}
+			return distortion;
+		}
+	};
+
+	// Estimates the perceptual distortion of a subframe after decoding, given its quantized bins
+	//  For each band, the squared error of the decoded bins is estimated, where the decoder's noise fill is accounted for by
+	//  its expected energy (the noise itself is uncorrelated with the original bins). The distortion is then the sum of the
+	//  bands' log noise-to-signal ratios (floored at -60dB), weighted by `BandDistortionWeight`. Weights are divided by the
+	//  number of subframes in the frame, so that short and long subframes covering the same time span count equally.
+	inline double SubframeDistortion(const SubframeAnalysis& subframe, const vector<int8_t>& binQStream)
+	{
+		return DispatchNumSubframes<SubframeDistortionKernel>(subframe.numSubframes, subframe, binQStream.data());
+	}
+
+	// Adaptive byte-oriented context model, used for estimating compressed stream sizes
+	//  Two predictions are made for each symbol, and mixed linearly with an adaptive weight:
+	//  - A sequential prediction, blending an order 2 model with an order 1 model, which is in turn blended with an order 0
+	//    model, which is blended with a uniform distribution (similar to PPM with blending instead of escapes).
+	//  - A "side" prediction, using a caller-provided side context (eg. the symbol at the same position in the previous
+	//    subframe), blended with the order 1 model. This captures inter-frame correlation, which packers find using
+	//    match/sparse models, but which a purely sequential model would miss.
+	//  Order 2 contexts only use the low 6 bits of each previous symbol, which keeps them small while keeping distinct the
+	//  low-magnitude (signed) symbols that dominate our streams.
+	class ContextModel
+	{
+	public:
+		ContextModel()
+			: order1Counts(NumSymbols * NumSymbols), order1Totals(NumSymbols), order2Counts(NumOrder2Contexts * NumSymbols), order2Totals(NumOrder2Contexts), sideCounts(NumSymbols * NumSymbols), sideTotals(NumSymbols)
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			fill(begin(order0Counts), end(order0Counts), 0);
+			order0Total = 0;
+			fill(order1Counts.begin(), order1Counts.end(), 0);
+			fill(order1Totals.begin(), order1Totals.end(), 0);
+			fill(order2Counts.begin(), order2Counts.end(), 0);
+			fill(order2Totals.begin(), order2Totals.end(), 0);
+			fill(sideCounts.begin(), sideCounts.end(), 0);
+			fill(sideTotals.begin(), sideTotals.end(), 0);
+			sideWeight = 0.5;
+			history = 0;
+		}
+
+		// Returns the cost (in bits) of coding the given symbol in the current context, and updates the model
+		double Encode(uint8_t symbol, uint8_t sideContext)
+		{
+			const auto prev1 = history & 0xff;
+			const auto prev2 = history >> 8;
+			const auto order1Context = prev1;
+			const auto order2Context = ((prev2 & 0x3f) << 6) | (prev1 & 0x3f);
+
+			auto& order0Count = order0Counts[symbol];
+			auto& order1Count = order1Counts[order1Context * NumSymbols + symbol];
+			auto& order1Total = order1Totals[order1Context];
+			auto& order2Count = order2Counts[order2Context * NumSymbols + symbol];
+			auto& order2Total = order2Totals[order2Context];
+			auto& sideCount = sideCounts[sideContext * NumSymbols + symbol];
+			auto& sideTotal = sideTotals[sideContext];
+
+			const auto order0Prob = (static_cast<double>(order0Count) + UniformBlendWeight / static_cast<double>(NumSymbols)) / (static_cast<double>(order0Total) + UniformBlendWeight);
+			const auto order1Prob = (static_cast<double>(order1Count) + ContextBlendWeight * order0Prob) / (static_cast<double>(order1Total) + ContextBlendWeight);
+			const auto order2Prob = (static_cast<double>(order2Count) + ContextBlendWeight * order1Prob) / (static_cast<double>(order2Total) + ContextBlendWeight);
+			const auto sideProb = (static_cast<double>(sideCount) + ContextBlendWeight * order1Prob) / (static_cast<double>(sideTotal) + ContextBlendWeight);
+			const auto prob = order2Prob + (sideProb - order2Prob) * sideWeight;
+
+			order0Count++;
+			order0Total++;
+			order1Count++;
+			order1Total++;
+			order2Count++;
+			order2Total++;
+			sideCount++;
+			sideTotal++;
+			history = ((history << 8) | symbol) & 0xffff;
+
+			// Adjust mixing weight along the coding cost gradient
+			sideWeight = clamp(sideWeight + MixLearningRate * (sideProb - order2Prob) / prob, 0.02, 0.98);
+
+			return -log2(prob);
+		}
+
+	private:
+		static constexpr uint32_t NumSymbols = 256;
+		static constexpr uint32_t NumOrder2Contexts = 1 << 12;
+		static constexpr double UniformBlendWeight = 1.0;
+		static constexpr double ContextBlendWeight = 2.0;
+		static constexpr double MixLearningRate = 0.002;
+
+		uint32_t order0Counts[NumSymbols];
+		uint32_t order0Total;
+		vector<uint32_t> order1Counts;
+		vector<uint32_t> order1Totals;
+		vector<uint32_t> order2Counts;
+		vector<uint32_t> order2Totals;
+		vector<uint32_t> sideCounts;
+		vector<uint32_t> sideTotals;
+		double sideWeight;
+		uint32_t history;
+	};
+
 	static void WriteCString(vector<uint8_t>& v, const char *s)
 	{
 		while (true)
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Common.hpp"
+
+#include <cstdint>
+
+namespace Pulsejet::Internal
+{
+	using namespace Shims;
+
+	static float VorbisWindow(const float nPlusHalf, const uint32_t size)
+	{
+		const auto sineWindow = SinF(static_cast<float>(M_PI) / static_cast<float>(size) * nPlusHalf);
+		return SinF(static_cast<float>(M_PI_2) * sineWindow * sineWindow);
+	}
+
+	// Evaluates the MDCT window for the given mode at a (possibly fractional) sample position, given as n + 0.5
+	inline float MdctWindow(const float nPlusHalf, const uint32_t size, const WindowMode mode)
+	{
+		if (mode == WindowMode::Start)
+		{
+			const auto shortWindowOffset = LongWindowSize * 3 / 4 - ShortWindowSize / 4;
+			if (nPlusHalf >= static_cast<float>(shortWindowOffset + ShortWindowSize / 2))
+			{
+				return 0.0f;
+			}
+			else if (nPlusHalf >= static_cast<float>(shortWindowOffset))
+			{
+				return 1.0f - VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
+			}
+			else if (nPlusHalf >= static_cast<float>(LongWindowSize / 2))
+			{
+				return 1.0f;
+			}
+		}
+		else if (mode == WindowMode::Stop)
+		{
+			const auto shortWindowOffset = LongWindowSize / 4 - ShortWindowSize / 4;
+			if (nPlusHalf < static_cast<float>(shortWindowOffset))
+			{
+				return 0.0f;
+			}
+			else if (nPlusHalf < static_cast<float>(shortWindowOffset + ShortWindowSize / 2))
+			{
+				return VorbisWindow(nPlusHalf - static_cast<float>(shortWindowOffset), ShortWindowSize);
+			}
+			else if (nPlusHalf < static_cast<float>(LongWindowSize / 2))
+			{
+				return 1.0f;
+			}
+		}
+		return VorbisWindow(nPlusHalf, size);
+	}
+
+	inline float MdctWindow(const uint32_t n, const uint32_t size, const WindowMode mode)
+	{
+		return MdctWindow(static_cast<float>(n) + 0.5f, size, mode);
+	}
+}
@@ -4,6 +4,7 @@
 #include "MetaHelpers.hpp"
 
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace Pulsejet
@@ -80,7 +81,8 @@ namespace Pulsejet
 	 */
 	inline bool CheckSample(const uint8_t *inputStream)
 	{
-		return !strcmp(reinterpret_cast<const char *>(inputStream), SampleTag);
+		// The tag isn't null-terminated in the stream, so only its characters are compared
+		return !strncmp(reinterpret_cast<const char *>(inputStream), SampleTag, strlen(SampleTag));
 	}
 
 	/**
@@ -101,4 +103,21 @@ namespace Pulsejet
 		const auto versionMajor = reinterpret_cast<const uint16_t *>(inputStream)[2];
 		return versionMajor == CodecVersionMajor;
 	}
+
+	/**
+	 * Returns the layout of the given encoded pulsejet byte stream.
+	 *
+	 * This function assumes that `inputStream` represents an encoded pulsejet
+	 * byte stream. `CheckSample` can be used to verify this assumption.
+	 *
+	 * See `StreamLayout` for more info.
+	 *
+	 * @param inputStream Encoded pulsejet byte stream.
+	 * @return The layout of the given encoded pulsejet byte stream.
+	 */
+	inline StreamLayout SampleLayout(const uint8_t *inputStream)
+	{
+		const auto numFramesField = reinterpret_cast<const uint16_t *>(inputStream)[4];
+		return (numFramesField & InterleavedLayoutFlag) ? StreamLayout::Interleaved : StreamLayout::Concatenated;
+	}
 }
@@ -1,5 +1,8 @@
 #pragma once
 
 #include "Decode.hpp"
+#include "DecodeFixed.hpp"
 #include "Encode.hpp"
+#include "EncodeBank.hpp"
 #include "Meta.hpp"
+#include "ReEncode.hpp"
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "BitsEstimators.hpp"
+#include "Common.hpp"
+#include "Encode.hpp"
+#include "EncodeHelpers.hpp"
+#include "Meta.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Pulsejet
+{
+	using namespace Internal;
+
+	using namespace std;
+
+	/**
+	 * Options for `ReEncode`.
+	 */
+	struct ReEncodeOptions
+	{
+		/**
+		 * Bits estimator used for rate control. If null, an
+		 * `Order0BitsEstimator` is used. Since rate control resumes in the
+		 * middle of the sample, the estimator must not keep statistics
+		 * across subframes, and should match the one used for the original
+		 * encode.
+		 */
+		BitsEstimator *bitsEstimator = nullptr;
+		/**
+		 * Once past the edited region, re-encoding stops at the first frame
+		 * after which the rate control slack bits are within this many bits
+		 * of the previous encoding's. Frames past that point keep their
+		 * previous encoding, so rate control for the rest of the sample is
+		 * off by at most this much compared to a full encode (see also
+		 * `maxConvergenceFrames`). 0 only stops when the state matches
+		 * exactly, which (with unlimited `maxConvergenceFrames`) makes the
+		 * result identical to a full encode, but typically re-encodes the
+		 * rest of the sample.
+		 */
+		double convergenceBits = 8.0;
+		/**
+		 * Re-encoding also stops at most this many frames past the last
+		 * frame whose analysis changed, even if the slack bits haven't
+		 * converged yet, carrying the remaining difference over to the
+		 * rest of the sample. This bounds the cost of each edit, as rate
+		 * control on stationary material often keeps spending the bits
+		 * saved (or making up for the bits spent) by an edit until the end
+		 * of the sample. `UINT32_MAX` doesn't limit re-encoding, and is
+		 * required for the result to be identical to a full encode.
+		 */
+		uint32_t maxConvergenceFrames = 8;
+	};
+
+	/**
+	 * Re-encodes an edited region of a previously-encoded sample, reusing the
+	 * previous encoding outside of it.
+	 *
+	 * Only the frames whose analysis windows or window modes depend on the
+	 * edited samples are re-analyzed. Rate control resumes from the saved
+	 * state at the start of the first of these frames, and continues until
+	 * it converges back to the previous encoding (see
+	 * `ReEncodeOptions::convergenceBits`), or for at most
+	 * `ReEncodeOptions::maxConvergenceFrames` frames past the edit. The results are then spliced
+	 * into the previous encoding's streams, and `state` is updated to match.
+	 *
+	 * The sample rate, target bit rate and stream layout of the previous
+	 * encoding are kept. If the sample's size changed, the whole sample is
+	 * encoded again instead.
+	 *
+	 * This function requires the same shims as `Encode`.
+	 *
+	 * @param encodedSample Previous encoding of the sample, as returned by
+	 *        `Encode` or a previous `ReEncode` call.
+	 * @param[in,out] state Encoder state of the previous encoding, as saved
+	 *                by `Encode` (see `EncodeOptions::state`). Updated to
+	 *                the state of the new encoding.
+	 * @param sampleStream Edited sample stream.
+	 * @param sampleStreamSize Edited sample stream size in samples.
+	 * @param editStart First edited sample.
+	 * @param editEnd One past the last edited sample.
+	 * @param[out] outTotalBitsEstimate Total bits estimate for the encoded
+	 *             sample (see `Encode`).
+	 * @param options Additional options.
+	 * @return Encoded sample stream.
+	 */
+	inline vector<uint8_t> ReEncode(const vector<uint8_t>& encodedSample, EncodeState& state, const float *sampleStream, const uint32_t sampleStreamSize, const uint32_t editStart, uint32_t editEnd, double& outTotalBitsEstimate, const ReEncodeOptions& options = ReEncodeOptions())
+	{
+		// Changing the sample's size moves all of its frames, so start over
+		const auto layout = SampleLayout(encodedSample.data());
+		if (sampleStreamSize != state.sampleStreamSize)
+		{
+			EncodeOptions encodeOptions;
+			encodeOptions.bitsEstimator = options.bitsEstimator;
+			encodeOptions.layout = layout;
+			encodeOptions.state = &state;
+			return Encode(sampleStream, sampleStreamSize, state.sampleRate, state.targetBitRate, outTotalBitsEstimate, encodeOptions);
+		}
+
+		const auto numFrames = static_cast<uint32_t>(state.frames.size());
+		const auto numPaddedSamples = NumPaddedSamples(numFrames);
+
+		editEnd = min(editEnd, sampleStreamSize);
+		if (editStart >= editEnd)
+		{
+			outTotalBitsEstimate = 0.0;
+			for (const auto& frameState : state.frames)
+				outTotalBitsEstimate += frameState.bitsEstimate;
+			return encodedSample;
+		}
+
+		// Determine the ranges of frames whose MDCTs and window modes depend on the edited samples
+		//  Each frame's MDCT covers the two frames of padded samples starting at the frame, and its window mode depends on
+		//  the transient flags of its neighbors, each of which depends on the frame's energy (covering one frame of padded
+		//  samples centered on its MDCT) and its predecessor's. Edits to the first frame are also mirrored into the head
+		//  padding, while the tail padding is always silence.
+		const auto paddedEditStart = editStart < FrameSize ? 0 : editStart + FrameSize;
+		const auto paddedEditEnd = editEnd + FrameSize;
+		const auto firstMdctFrame = max(paddedEditStart / FrameSize, 1u) - 1;
+		const auto lastMdctFrame = min((paddedEditEnd - 1) / FrameSize, numFrames - 1);
+		const auto firstFrame = max(paddedEditStart / FrameSize, 2u) - 2;
+		const auto lastFrame = min((paddedEditEnd - 1) / FrameSize + 2, numFrames - 1);
+
+		// Redetermine window modes for these frames
+		const auto useShortWindows = state.targetBitRate > 8.0;
+		vector<float> frameSamples(LongWindowSize);
+		const auto firstTransientFrame = max(firstFrame, 1u) - 1;
+		const auto lastTransientFrame = min(lastFrame + 1, numFrames - 1);
+		float lastFrameEnergy = 0.0f;
+		if (firstTransientFrame > 0)
+		{
+			const auto frameOffset = (firstTransientFrame - 1) * FrameSize;
+			ReadPaddedSamples(sampleStream, sampleStreamSize, numPaddedSamples, frameOffset, frameOffset + LongWindowSize, frameSamples.data());
+			lastFrameEnergy = FrameEnergy(frameSamples.data());
+		}
+		vector<bool> isTransientFrameMap;
+		for (auto frameIndex = firstTransientFrame; frameIndex <= lastTransientFrame; frameIndex++)
+		{
+			const auto frameOffset = frameIndex * FrameSize;
+			ReadPaddedSamples(sampleStream, sampleStreamSize, numPaddedSamples, frameOffset, frameOffset + LongWindowSize, frameSamples.data());
+			const auto frameEnergy = FrameEnergy(frameSamples.data());
+			isTransientFrameMap.push_back(frameEnergy >= lastFrameEnergy * 2.0f);
+			lastFrameEnergy = frameEnergy;
+		}
+		vector<WindowMode> windowModes;
+		for (auto frameIndex = firstFrame; frameIndex <= lastFrame; frameIndex++)
+		{
+			const auto mapIndex = frameIndex - firstTransientFrame;
+			const auto isPrevFrameTransientFrame = frameIndex > 0 && isTransientFrameMap[mapIndex - 1];
+			const auto isNextFrameTransientFrame = frameIndex < numFrames - 1 && isTransientFrameMap[mapIndex + 1];
+			windowModes.push_back(ChooseWindowMode(isPrevFrameTransientFrame, isTransientFrameMap[mapIndex], isNextFrameTransientFrame, useShortWindows));
+		}
+
+		// Frames at the start of the range whose MDCTs and window modes are unchanged would be encoded exactly as before,
+		//  so re-encoding starts at the first changed frame; likewise, frames at the end of the range whose MDCTs and
+		//  window modes are unchanged only differ by their rate control and band energy prediction state
+		auto startFrame = firstFrame;
+		while (startFrame < firstMdctFrame && windowModes[startFrame - firstFrame] == state.frames[startFrame].windowMode)
+			startFrame++;
+		auto lastChangedFrame = lastFrame;
+		while (lastChangedFrame > lastMdctFrame && windowModes[lastChangedFrame - firstFrame] == state.frames[lastChangedFrame].windowMode)
+			lastChangedFrame--;
+
+		// Set up bits estimator
+		Order0BitsEstimator defaultBitsEstimator;
+		auto& bitsEstimator = options.bitsEstimator ? *options.bitsEstimator : defaultBitsEstimator;
+		bitsEstimator.Reset();
+
+		// Determine target bits/frame
+		const auto targetBitsPerFrame = state.targetBitRate * 1000.0 * (static_cast<double>(FrameSize) / state.sampleRate);
+
+		// Resume from the state at the end of the preceding frame
+		uint8_t quantizedBandEnergyPredictions[NumBands] = {};
+		double slackBits = 0.0;
+		if (startFrame > 0)
+		{
+			const auto& prevFrameState = state.frames[startFrame - 1];
+			copy(begin(prevFrameState.quantizedBandEnergyPredictions), end(prevFrameState.quantizedBandEnergyPredictions), quantizedBandEnergyPredictions);
+			slackBits = prevFrameState.slackBits;
+		}
+
+		// Re-encode frames until we're past the changed frames and have converged back to the previous encoding, or have
+		//  given up on converging
+		//  Frames past the changed frames keep their window modes, and their analysis is unchanged, except for the band
+		//  energy prediction of the first frame after them.
+		vector<EncodeFrameState> frameStates;
+		vector<uint8_t> binQStream;
+		vector<uint8_t> bandEnergyStream;
+		vector<SubframeAnalysis> subframes;
+		vector<int8_t> candidateBinQStream;
+		candidateBinQStream.reserve(FrameSize);
+		vector<int8_t> subframeBinQStream;
+		auto endFrame = startFrame;
+		double slackBitsOffset = 0.0;
+		while (endFrame < numFrames)
+		{
+			const auto frameIndex = endFrame++;
+
+			EncodeFrameState frameState;
+			frameState.windowMode = frameIndex <= lastFrame ? windowModes[frameIndex - firstFrame] : state.frames[frameIndex].windowMode;
+			frameState.bitsEstimate = 0.0;
+
+			const auto frameOffset = frameIndex * FrameSize;
+			ReadPaddedSamples(sampleStream, sampleStreamSize, numPaddedSamples, frameOffset, frameOffset + LongWindowSize, frameSamples.data());
+			subframes.clear();
+			AnalyzeFrame(frameSamples.data(), frameState.windowMode, quantizedBandEnergyPredictions, subframes);
+			for (const auto& subframe : subframes)
+			{
+				frameState.bitsEstimate += EncodeSubframe(subframe, targetBitsPerFrame, bitsEstimator, slackBits, candidateBinQStream, subframeBinQStream);
+				binQStream.insert(binQStream.end(), subframeBinQStream.begin(), subframeBinQStream.end());
+				bandEnergyStream.insert(bandEnergyStream.end(), subframe.bandEnergyStream.begin(), subframe.bandEnergyStream.end());
+			}
+
+			copy(begin(quantizedBandEnergyPredictions), end(quantizedBandEnergyPredictions), frameState.quantizedBandEnergyPredictions);
+			frameState.slackBits = slackBits;
+			frameStates.push_back(frameState);
+
+			const auto& prevFrameState = state.frames[frameIndex];
+			if (frameIndex >= lastChangedFrame &&
+				equal(begin(quantizedBandEnergyPredictions), end(quantizedBandEnergyPredictions), prevFrameState.quantizedBandEnergyPredictions) &&
+				(abs(slackBits - prevFrameState.slackBits) <= options.convergenceBits || frameIndex - lastChangedFrame >= options.maxConvergenceFrames))
+			{
+				slackBitsOffset = slackBits - prevFrameState.slackBits;
+				break;
+			}
+		}
+
+		// Locate the re-encoded frames in the previous encoding, after its header (tag, version and frame count field)
+		//  Each frame has the same number of bins regardless of its window mode, but band energies are stored per subframe.
+		const auto headerSize = strlen(SampleTag) + sizeof(uint16_t) * 3;
+		size_t numSubframesBefore = 0;
+		for (uint32_t frameIndex = 0; frameIndex < startFrame; frameIndex++)
+			numSubframesBefore += NumSubframes(state.frames[frameIndex].windowMode);
+		size_t numPrevSubframes = 0;
+		for (auto frameIndex = startFrame; frameIndex < endFrame; frameIndex++)
+			numPrevSubframes += NumSubframes(state.frames[frameIndex].windowMode);
+		const auto numSubframes = bandEnergyStream.size() / NumBands;
+
+		// Splice re-encoded frames into the previous encoding
+		vector<uint8_t> v;
+		v.reserve(encodedSample.size() - numPrevSubframes * NumBands + numSubframes * NumBands);
+		const auto prevStream = encodedSample.begin();
+		if (layout == StreamLayout::Interleaved)
+		{
+			const auto frameStart = [&](uint32_t frameIndex, size_t numSubframesBefore)
+			{
+				return headerSize + frameIndex * (1 + NumTotalBins) + numSubframesBefore * NumBands;
+			};
+			v.insert(v.end(), prevStream, prevStream + frameStart(startFrame, numSubframesBefore));
+			auto frameBinQs = binQStream.begin();
+			auto frameBandEnergies = bandEnergyStream.begin();
+			for (const auto& frameState : frameStates)
+			{
+				const auto numFrameBandEnergies = NumSubframes(frameState.windowMode) * NumBands;
+				v.push_back(static_cast<uint8_t>(frameState.windowMode));
+				v.insert(v.end(), frameBinQs, frameBinQs + NumTotalBins);
+				v.insert(v.end(), frameBandEnergies, frameBandEnergies + numFrameBandEnergies);
+				frameBinQs += NumTotalBins;
+				frameBandEnergies += numFrameBandEnergies;
+			}
+			v.insert(v.end(), prevStream + frameStart(endFrame, numSubframesBefore + numPrevSubframes), encodedSample.end());
+		}
+		else
+		{
+			const auto binQStreamStart = headerSize + numFrames;
+			const auto bandEnergyStreamStart = binQStreamStart + numFrames * NumTotalBins;
+
+			v.insert(v.end(), prevStream, prevStream + headerSize + startFrame);
+			for (const auto& frameState : frameStates)
+				v.push_back(static_cast<uint8_t>(frameState.windowMode));
+			v.insert(v.end(), prevStream + headerSize + endFrame, prevStream + binQStreamStart + startFrame * NumTotalBins);
+			v.insert(v.end(), binQStream.begin(), binQStream.end());
+			v.insert(v.end(), prevStream + binQStreamStart + endFrame * NumTotalBins, prevStream + bandEnergyStreamStart + numSubframesBefore * NumBands);
+			v.insert(v.end(), bandEnergyStream.begin(), bandEnergyStream.end());
+			v.insert(v.end(), prevStream + bandEnergyStreamStart + (numSubframesBefore + numPrevSubframes) * NumBands, encodedSample.end());
+		}
+
+		// Update state
+		//  Frames past the re-encoded ones keep their encoding, so they carry over any remaining slack bits difference.
+		copy(frameStates.begin(), frameStates.end(), state.frames.begin() + startFrame);
+		for (auto frameIndex = endFrame; frameIndex < numFrames; frameIndex++)
+			state.frames[frameIndex].slackBits += slackBitsOffset;
+
+		outTotalBitsEstimate = 0.0;
+		for (const auto& frameState : state.frames)
+			outTotalBitsEstimate += frameState.bitsEstimate;
+
+		return v;
+	}
+}